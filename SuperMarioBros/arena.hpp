@@ -0,0 +1,124 @@
+#ifndef MLPACK_METHODS_NEURO_CMAES_ARENA_HPP
+#define MLPACK_METHODS_NEURO_CMAES_ARENA_HPP
+
+/**
+ * @file arena.hpp
+ * @author www.github.com/Kartik-Nighania
+ *
+ * Single block allocator for the state of an optimizer instance.
+ */
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include <sys/mman.h>
+
+#include "utils.hpp"
+
+namespace mlpack {
+namespace neuro_cmaes {
+
+/**
+ * @class Arena
+ * Bump allocator that hands out cache-line aligned slices of one block.
+ *
+ * The layout is built in two passes over the same sequence of take() calls:
+ * before allocate() the calls only add up the required size and return NULL,
+ * after allocate() they return the actual slices. All slices are released
+ * together when the arena is reset or destroyed.
+ */
+class Arena
+{
+public:
+  //! Alignment of the block when huge pages are requested.
+  static const size_t hugePageSize = size_t(2) << 20;
+
+  Arena() : base(0), capacity(0), offset(0) {}
+
+  Arena(Arena&& other)
+      : base(other.base), capacity(other.capacity), offset(other.offset)
+  {
+    other.base = 0;
+    other.capacity = other.offset = 0;
+  }
+
+  ~Arena()
+  {
+    free(base);
+  }
+
+  /**
+   * Releases the block and starts a new measuring pass.
+   */
+  void reset()
+  {
+    free(base);
+    base = 0;
+    capacity = offset = 0;
+  }
+
+  /**
+   * Allocates a block of the size measured since the last reset() and
+   * rewinds, so that the same take() calls now return memory.
+   * @param hugePages Align the block to a huge page and advise the kernel
+   *                  to back it with transparent huge pages.
+   */
+  void allocate(bool hugePages = false)
+  {
+    assert(!base && "allocate(): arena was already allocated");
+    const size_t alignment = hugePages ? hugePageSize : cacheLineSize;
+    capacity = std::max(offset, cacheLineSize);
+    if(hugePages)
+      capacity = (capacity + hugePageSize - 1) / hugePageSize * hugePageSize;
+
+    void* p = 0;
+    if(posix_memalign(&p, alignment, capacity))
+      throw std::bad_alloc();
+    base = static_cast<char*>(p);
+    offset = 0;
+
+#ifdef MADV_HUGEPAGE
+    if(hugePages)
+      madvise(base, capacity, MADV_HUGEPAGE);
+#endif
+  }
+
+  /**
+   * @return A slice of n elements starting on a cache line, or NULL during
+   *         the measuring pass.
+   */
+  template<typename U>
+  U* take(size_t n)
+  {
+    const size_t bytes = (n*sizeof(U) + cacheLineSize - 1) / cacheLineSize
+        * cacheLineSize;
+    U* p = base ? reinterpret_cast<U*>(base + offset) : 0;
+    offset += bytes;
+    assert((!base || offset <= capacity) && "take(): arena layout changed");
+    return p;
+  }
+
+  //! Whether allocate() was called, i.e. take() returns memory.
+  bool allocated() const { return base != 0; }
+
+  //! Number of bytes handed out or measured so far.
+  size_t size() const { return offset; }
+
+private:
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+
+  //! The block, NULL while measuring.
+  char* base;
+  //! Size of the block in bytes.
+  size_t capacity;
+  //! Bytes taken so far.
+  size_t offset;
+};
+
+}  // namespace neuro_cmaes
+}  // namespace mlpack
+
+#endif  // MLPACK_METHODS_NEURO_CMAES_ARENA_HPP
@@ -0,0 +1,789 @@
+#ifndef MLPACK_METHODS_NEURO_CMAES_BATCH_CMAES_HPP
+#define MLPACK_METHODS_NEURO_CMAES_BATCH_CMAES_HPP
+
+/**
+ * @file batch_cmaes.hpp
+ * @author www.github.com/Kartik-Nighania
+ *
+ * CMA-ES on many independent problems of the same size at once.
+ */
+
+#include <cassert>
+#include <cmath>
+#include <ctime>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "arena.hpp"
+#include "parameters.hpp"
+#include "random.hpp"
+#include "stats.hpp"
+#include "symmetric_eigen.hpp"
+#include "thread_pool.hpp"
+#include "utils.hpp"
+
+namespace mlpack {
+namespace neuro_cmaes {
+
+/**
+ * @class BatchCMAES
+ * Runs K independent CMA-ES instances that share dimension, population size
+ * and strategy parameters, e.g. for hyperparameter studies.
+ *
+ * The state of all instances is stored as structure of arrays: element i of
+ * a vector (or element (i, j) of a matrix) of instance k is found at
+ * [i*lanes + k], so that the kernels run their inner loops over contiguous
+ * instances. Sampling, selection and the covariance update of all instances
+ * are done together, split over the threads of a pool by cache lines of
+ * instances, or by single instances if there are fewer cache lines than
+ * threads. Each instance draws from its own random number generator, so
+ * the results do not depend on the number of threads.
+ *
+ * The batched engine always uses a single full covariance matrix per
+ * instance; init() rejects diagonalCov and blockSizes.
+ */
+template<typename T>
+class BatchCMAES
+{
+public:
+  /**
+   * @param threads Number of threads used by the kernels.
+   */
+  explicit BatchCMAES(int threads = 1) : pool(threads), K(0) {}
+
+  /**
+   * Initializes K instances with a private copy of the parameters.
+   */
+  T* init(const Parameters<T>& parameters, int instances,
+      unsigned long seed = 0)
+  {
+    return init(std::make_shared<const Parameters<T> >(parameters), instances,
+        seed);
+  }
+
+  /**
+   * Initializes K instances that all use the given parameter block.
+   * @param parameters Initialized CMA-ES parameters.
+   * @param instances Number of instances K.
+   * @param seed Instance k uses seed + k, the clock is used for seed == 0.
+   * @return Array of K*lambda fitness values to be filled and passed to
+   *         updateDistribution(); instance k owns [k*lambda, (k+1)*lambda).
+   */
+  T* init(const SharedParameters<T>& parameters, int instances,
+      unsigned long seed = 0)
+  {
+    assert(parameters && instances > 0 && "init(): invalid arguments");
+    if(parameters->diagonalCov != 0)
+      throw std::invalid_argument("init(): BatchCMAES does not support "
+          "diagonalCov");
+    if(parameters->blockSizes.size() > 1)
+      throw std::invalid_argument("init(): BatchCMAES does not support "
+          "covariance blocks");
+    params = parameters;
+    K = instances;
+    N = params->N;
+    lambda = params->lambda;
+    mu = params->mu;
+    lanes = paddedLength<T>(K);
+    laneBlocks = lanes / (int) (cacheLineSize / sizeof(T));
+    rowStride = paddedLength<T>(N);
+    historySize = 10 + (int) std::ceil(3.*10.*N/lambda);
+
+    arena.reset();
+    carve();
+    arena.allocate(params->hugePages);
+    carve();
+
+    if(!seed)
+      seed = (unsigned long) time(0);
+    rand.assign(K, CounterRandom<T>(seed));
+    for(int k = 0; k < K; ++k)
+      rand[k].start(seed + k);
+
+    T trace(0);
+    for(int i = 0; i < N; ++i)
+      trace += params->rgInitialStds[i]*params->rgInitialStds[i];
+    chiN = std::sqrt((T) N) * (T(1) - T(1)/(T(4)*N) + T(1)/(T(21)*N*N));
+
+    T dtest;
+    for(dtest = T(1); dtest && dtest < T(1.1)*dtest; dtest *= T(2))
+      if(dtest == dtest + T(1))
+        break;
+    dMaxSignifKond = dtest / T(1000);
+
+    gen = 0;
+    countevals = 0;
+    genOfEigensysUpdate = 0;
+    eigensysIsUptodate = true;
+
+    std::fill(C, C + (size_t) N*(N + 1)/2*lanes, T(0));
+    std::fill(B, B + (size_t) N*N*lanes, T(0));
+    std::fill(pc, pc + (size_t) N*lanes, T(0));
+    std::fill(ps, ps + (size_t) N*lanes, T(0));
+    for(int i = 0; i < N; ++i)
+    {
+      const T d = params->rgInitialStds[i]*std::sqrt(N/trace);
+      for(int k = 0; k < lanes; ++k)
+      {
+        rgD[i*lanes + k] = d;
+        C[tri(i, i)*lanes + k] = d*d;
+        B[((size_t) i*N + i)*lanes + k] = T(1);
+        xmean[i*lanes + k] = xold[i*lanes + k] = params->xstart[i];
+      }
+    }
+    for(int k = 0; k < lanes; ++k)
+    {
+      sigma[k] = std::sqrt(trace/N);
+      minEW[k] = square(minElement(params->rgInitialStds, N))*N/trace;
+      maxEW[k] = square(maxElement(params->rgInitialStds, N))*N/trace;
+    }
+    if(params->typicalXcase)
+      for(int k = 0; k < K; ++k)
+      {
+        rand[k].gauss(0, 0, z + k, N, lanes);
+        for(int i = 0; i < N; ++i)
+          xmean[i*lanes + k] += sigma[k]*rgD[i*lanes + k]*z[i*lanes + k];
+      }
+
+    for(int k = 0; k < K; ++k)
+    {
+      bestFitness[k] = std::numeric_limits<T>::max();
+      for(int i = 0; i < historySize; ++i)
+        funcValueHistory[k*historySize + i] = std::numeric_limits<T>::max();
+    }
+    for(int i = 0; i < K*lambda; ++i)
+    {
+      functionValues[i] = std::numeric_limits<T>::max();
+      index[i] = i % lambda;
+    }
+
+    return publicFitness;
+  }
+
+  /**
+   * Samples lambda offspring for every instance.
+   * @return K*lambda N-dimensional vectors, offspring l of instance k is
+   *         element k*lambda + l.
+   */
+  T* const* samplePopulation()
+  {
+    if(!eigensysIsUptodate &&
+        gen >= genOfEigensysUpdate + params->updateCmode.modulo)
+      updateEigensystems();
+
+    {
+      NEURO_CMAES_TIME(sample);
+      forLanes([this](int k0, int k1) { sampleLanes(k0, k1); });
+    }
+
+    ++gen;
+    return candidates;
+  }
+
+  /**
+   * Updates the search distributions of all instances.
+   * @param fitnessValues K*lambda function values ordered like the return
+   *        value of samplePopulation().
+   */
+  void updateDistribution(const T* fitnessValues)
+  {
+    countevals += lambda;
+    {
+      NEURO_CMAES_TIME(sort);
+      forLanes([this, fitnessValues](int k0, int k1)
+      {
+        selectLanes(fitnessValues, k0, k1);
+      });
+    }
+    {
+      NEURO_CMAES_TIME(mean);
+      forLanes([this](int k0, int k1) { recombineLanes(k0, k1); });
+    }
+    {
+      NEURO_CMAES_TIME(adaptC2);
+      forLanes([this](int k0, int k1) { adaptLanes(k0, k1); });
+    }
+    eigensysIsUptodate = false;
+  }
+
+  /**
+   * Tests the stop criteria of instance k, those of
+   * CMAES::testForTermination(): fitness target, TolFun, TolFunHist, TolX,
+   * TolUpX, condition number, NoEffectAxis, NoEffectCoordinate, MaxFunEvals
+   * and MaxIter.
+   */
+  bool testForTermination(int k) const
+  {
+    const T* f = functionValues + k*lambda;
+    const T* history = funcValueHistory + k*historySize;
+
+    if(gen > 1 && params->stStopFitness.flg &&
+        f[index[k*lambda]] <= params->stStopFitness.val)
+      return true;
+
+    const int h = (int) std::min(gen, (T) historySize);
+    if(gen > 0 && h > 0 &&
+        std::max(maxElement(history, h), maxElement(f, lambda)) -
+        std::min(minElement(history, h), minElement(f, lambda))
+        <= params->stopTolFun)
+      return true;
+
+    if(gen > historySize && maxElement(history, historySize) -
+        minElement(history, historySize) <= params->stopTolFunHist)
+      return true;
+
+    int cTemp = 0;
+    for(int i = 0; i < N; ++i)
+    {
+      cTemp += (sigma[k]*std::sqrt(C[tri(i, i)*lanes + k]) < params->stopTolX);
+      cTemp += (sigma[k]*pc[i*lanes + k] < params->stopTolX);
+    }
+    if(cTemp == 2*N)
+      return true;
+
+    for(int i = 0; i < N; ++i)
+      if(sigma[k]*std::sqrt(C[tri(i, i)*lanes + k]) >
+          params->stopTolUpXFactor*params->rgInitialStds[i])
+        return true;
+
+    if(maxEW[k] >= minEW[k]*dMaxSignifKond)
+      return true;
+
+    // principal axis a has no effect on xmean
+    for(int a = 0; a < N; ++a)
+    {
+      const T fac = T(0.1)*sigma[k]*rgD[a*lanes + k];
+      int i = 0;
+      while(i < N && xmean[i*lanes + k] ==
+          xmean[i*lanes + k] + fac*B[((size_t) i*N + a)*lanes + k])
+        ++i;
+      if(i == N)
+        return true;
+    }
+
+    // component of xmean is not changed anymore
+    for(int i = 0; i < N; ++i)
+      if(xmean[i*lanes + k] == xmean[i*lanes + k] +
+          sigma[k]*std::sqrt(C[tri(i, i)*lanes + k])/T(5))
+        return true;
+
+    return countevals >= params->stopMaxFunEvals || gen >= params->stopMaxIter;
+  }
+
+  //! Number of instances K.
+  int instances() const { return K; }
+
+  T dimension() const { return N; }
+
+  T sampleSize() const { return lambda; }
+
+  T generation() const { return gen; }
+
+  //! Function evaluations per instance.
+  T evaluation() const { return countevals; }
+
+  T sigmaValue(int k) const { return sigma[k]; }
+
+  T fitnessBestEver(int k) const { return bestFitness[k]; }
+
+  const T* XBestEver(int k) const { return xBestEver + (size_t) k*N; }
+
+  /**
+   * Phase timings summed over all instances, see CMAES::statistics(). Only
+   * recorded if NEURO_CMAES_STATS is defined; the termination tests are not
+   * timed.
+   */
+  const CMAESStats& statistics() const
+  {
+    return stats;
+  }
+
+  /**
+   * Copies the mean of instance k into x, which must hold N values.
+   */
+  T* XMean(int k, T* x) const
+  {
+    for(int i = 0; i < N; ++i)
+      x[i] = xmean[i*lanes + k];
+    return x;
+  }
+
+private:
+  //! Offset of element (i, j), j <= i, in the packed lower triangle.
+  static size_t tri(int i, int j)
+  {
+    return (size_t) i*(i + 1)/2 + j;
+  }
+
+  /**
+   * Instances [k0, k1) handled by thread t, in whole cache lines if there
+   * are at least as many cache lines as threads. Otherwise the instances
+   * are split one by one, so that all threads get work even though some of
+   * them share cache lines.
+   */
+  void laneRange(int t, int& k0, int& k1) const
+  {
+    if(laneBlocks < pool.size())
+    {
+      ThreadPool::chunk(0, K, pool.size(), t, k0, k1);
+      return;
+    }
+
+    const int perLine = (int) (cacheLineSize / sizeof(T));
+    int b0, b1;
+    ThreadPool::chunk(0, laneBlocks, pool.size(), t, b0, b1);
+    k0 = std::min(b0*perLine, K);
+    k1 = std::min(b1*perLine, K);
+  }
+
+  /**
+   * Calls f(k0, k1) on the instances of every thread, see laneRange().
+   */
+  template<typename F>
+  void forLanes(const F& f)
+  {
+    pool.parallelFor(0, pool.size(), [this, &f](int first, int last)
+    {
+      for(int t = first; t < last; ++t)
+      {
+        int k0, k1;
+        laneRange(t, k0, k1);
+        if(k0 < k1)
+          f(k0, k1);
+      }
+    });
+  }
+
+  /**
+   * Points all arrays into the arena, see CMAES::carve().
+   */
+  void carve()
+  {
+    const int threads = pool.size();
+
+    B = arena.take<T>((size_t) N*N*lanes);
+    C = arena.take<T>((size_t) N*(N + 1)/2*lanes);
+    population = arena.take<T>((size_t) lambda*N*lanes);
+    steps = arena.take<T>((size_t) mu*N*lanes);
+    T* candidateBlock = arena.take<T>((size_t) K*lambda*N);
+    candidates = arena.take<T*>((size_t) K*lambda);
+    T* eigenBlock = arena.take<T>((size_t) threads*N*rowStride);
+    eigenRows = arena.take<T*>((size_t) threads*N);
+    eigenValues = arena.take<T>((size_t) threads*N);
+    eigenTemp = arena.take<T>((size_t) threads*(N + 1));
+    eigenSub = arena.take<T>((size_t) N*lanes);
+    eigenWork = arena.take<T>((size_t) 4*lanes);
+
+    xmean = arena.take<T>((size_t) N*lanes);
+    xold = arena.take<T>((size_t) N*lanes);
+    pc = arena.take<T>((size_t) N*lanes);
+    ps = arena.take<T>((size_t) N*lanes);
+    rgD = arena.take<T>((size_t) N*lanes);
+    BDz = arena.take<T>((size_t) N*lanes);
+    z = arena.take<T>((size_t) N*lanes);
+    acc = arena.take<T>(lanes);
+    sigma = arena.take<T>(lanes);
+    psxps = arena.take<T>(lanes);
+    decay = arena.take<T>(lanes);
+    hsig = arena.take<T>(lanes);
+    minEW = arena.take<T>(lanes);
+    maxEW = arena.take<T>(lanes);
+
+    publicFitness = arena.take<T>((size_t) K*lambda);
+    functionValues = arena.take<T>((size_t) K*lambda);
+    index = arena.take<int>((size_t) K*lambda);
+    funcValueHistory = arena.take<T>((size_t) K*historySize);
+    xBestEver = arena.take<T>((size_t) K*N);
+    bestFitness = arena.take<T>(K);
+
+    if(!arena.allocated())
+      return;
+
+    for(int i = 0; i < K*lambda; ++i)
+      candidates[i] = candidateBlock + (size_t) i*N;
+    for(int i = 0; i < threads*N; ++i)
+      eigenRows[i] = eigenBlock + (size_t) i*rowStride;
+  }
+
+  /**
+   * Draws lambda offspring for instances [k0, k1).
+   */
+  void sampleLanes(const int k0, const int k1)
+  {
+    for(int l = 0; l < lambda; ++l)
+    {
+      // scaled random vectors D*z, offspring l of generation g of instance
+      // k is drawn from stream (g, l) of rand[k]
+      for(int k = k0; k < k1; ++k)
+      {
+        rand[k].gauss((uint64_t) gen + 1, l, z + k, N, lanes);
+        for(int j = 0; j < N; ++j)
+          z[j*lanes + k] *= rgD[j*lanes + k];
+      }
+
+      // x = xmean + sigma*B*(D*z)
+      for(int i = 0; i < N; ++i)
+      {
+        for(int k = k0; k < k1; ++k)
+          acc[k] = T(0);
+        const T* Bi = B + (size_t) i*N*lanes;
+        for(int j = 0; j < N; ++j)
+        {
+          const T* Bij = Bi + (size_t) j*lanes;
+          const T* zj = z + j*lanes;
+          for(int k = k0; k < k1; ++k)
+            acc[k] += Bij[k]*zj[k];
+        }
+        T* xli = population + ((size_t) l*N + i)*lanes;
+        const T* xi = xmean + i*lanes;
+        for(int k = k0; k < k1; ++k)
+          xli[k] = xi[k] + sigma[k]*acc[k];
+      }
+    }
+
+    // contiguous copies for the objective function
+    for(int k = k0; k < k1; ++k)
+      for(int l = 0; l < lambda; ++l)
+      {
+        T* x = candidates[k*lambda + l];
+        const T* xl = population + (size_t) l*N*lanes + k;
+        for(int i = 0; i < N; ++i)
+          x[i] = xl[(size_t) i*lanes];
+      }
+  }
+
+  /**
+   * Sorting and bookkeeping of the offspring of instances [k0, k1), the
+   * first step of updateDistribution().
+   */
+  void selectLanes(const T* fitnessValues, const int k0, const int k1)
+  {
+    const T cs = params->cs;
+
+    // per instance bookkeeping
+    for(int k = k0; k < k1; ++k)
+    {
+      const T* f = fitnessValues + k*lambda;
+      int* idx = index + k*lambda;
+      std::copy(f, f + lambda, functionValues + k*lambda);
+      sortIndex(f, idx, lambda);
+
+      // escape flat fitness
+      if(f[idx[0]] == f[idx[lambda / 2]])
+        sigma[k] *= std::exp(T(0.2) + cs / params->damps);
+
+      T* history = funcValueHistory + k*historySize;
+      for(int i = historySize - 1; i > 0; --i)
+        history[i] = history[i - 1];
+      history[0] = f[idx[0]];
+
+      if(f[idx[0]] < bestFitness[k])
+      {
+        bestFitness[k] = f[idx[0]];
+        std::copy(candidates[k*lambda + idx[0]],
+            candidates[k*lambda + idx[0]] + N, xBestEver + (size_t) k*N);
+      }
+    }
+  }
+
+  /**
+   * Recombination and update of the evolution paths of instances [k0, k1),
+   * see CMAES::updateDistribution().
+   */
+  void recombineLanes(const int k0, const int k1)
+  {
+    const T* w = params->weights;
+    const T cs = params->cs;
+
+    // recombination, BDz = sqrt(mueff)*(xmean - xold)/sigma
+    const T sqrtmueff = std::sqrt(params->mueff);
+    for(int i = 0; i < N; ++i)
+    {
+      T* xm = xmean + i*lanes;
+      T* xo = xold + i*lanes;
+      T* bdz = BDz + i*lanes;
+      for(int k = k0; k < k1; ++k)
+      {
+        xo[k] = xm[k];
+        xm[k] = T(0);
+      }
+      for(int r = 0; r < mu; ++r)
+        for(int k = k0; k < k1; ++k)
+          xm[k] += w[r]*population[((size_t) index[k*lambda + r]*N + i)*lanes
+              + k];
+      for(int k = k0; k < k1; ++k)
+        bdz[k] = sqrtmueff*(xm[k] - xo[k])/sigma[k];
+    }
+
+    // z = D^(-1)*B^T*BDz
+    for(int i = 0; i < N; ++i)
+    {
+      T* zi = z + i*lanes;
+      for(int k = k0; k < k1; ++k)
+        zi[k] = T(0);
+      for(int j = 0; j < N; ++j)
+      {
+        const T* Bji = B + ((size_t) j*N + i)*lanes;
+        const T* bdz = BDz + j*lanes;
+        for(int k = k0; k < k1; ++k)
+          zi[k] += Bji[k]*bdz[k];
+      }
+      const T* di = rgD + i*lanes;
+      for(int k = k0; k < k1; ++k)
+        zi[k] /= di[k];
+    }
+
+    // cumulation for sigma (ps) using B*z
+    const T sqrtFactor = std::sqrt(cs*(T(2) - cs));
+    const T invps = T(1) - cs;
+    for(int k = k0; k < k1; ++k)
+      psxps[k] = T(0);
+    for(int i = 0; i < N; ++i)
+    {
+      for(int k = k0; k < k1; ++k)
+        acc[k] = T(0);
+      const T* Bi = B + (size_t) i*N*lanes;
+      for(int j = 0; j < N; ++j)
+      {
+        const T* Bij = Bi + (size_t) j*lanes;
+        const T* zj = z + j*lanes;
+        for(int k = k0; k < k1; ++k)
+          acc[k] += Bij[k]*zj[k];
+      }
+      T* psi = ps + i*lanes;
+      for(int k = k0; k < k1; ++k)
+      {
+        psi[k] = invps*psi[k] + sqrtFactor*acc[k];
+        psxps[k] += psi[k]*psi[k];
+      }
+    }
+
+    // cumulation for covariance matrix (pc) using B*D*z~N(0,C)
+    const T ccumcov = params->ccumcov;
+    const T hsigNorm = std::sqrt(T(1) - std::pow(T(1) - cs, T(2)*gen))*chiN;
+    const T hsigFactor = std::sqrt(ccumcov*(T(2) - ccumcov));
+    for(int k = k0; k < k1; ++k)
+      hsig[k] = std::sqrt(psxps[k]) / hsigNorm < T(1.4) + T(2) / (N + 1);
+    for(int i = 0; i < N; ++i)
+    {
+      T* pci = pc + i*lanes;
+      const T* bdz = BDz + i*lanes;
+      for(int k = k0; k < k1; ++k)
+        pci[k] = (T(1) - ccumcov)*pci[k] + hsig[k]*hsigFactor*bdz[k];
+    }
+  }
+
+  /**
+   * Covariance and step size update of instances [k0, k1), see
+   * CMAES::adaptC2().
+   */
+  void adaptLanes(const int k0, const int k1)
+  {
+    const T* w = params->weights;
+    const T cs = params->cs;
+    const T ccumcov = params->ccumcov;
+
+    // scaled steps of the selected offspring
+    for(int r = 0; r < mu; ++r)
+      for(int i = 0; i < N; ++i)
+      {
+        T* y = steps + ((size_t) r*N + i)*lanes;
+        const T* xo = xold + i*lanes;
+        for(int k = k0; k < k1; ++k)
+          y[k] = (population[((size_t) index[k*lambda + r]*N + i)*lanes + k]
+              - xo[k])/sigma[k];
+      }
+
+    // rank-one and rank-mu update of the lower triangles
+    const T mucovinv = T(1)/params->mucov;
+    const T ccov1 = std::min(params->ccov*mucovinv, T(1));
+    const T ccovmu = std::min(params->ccov*(T(1) - mucovinv), T(1) - ccov1);
+    for(int k = k0; k < k1; ++k)
+      decay[k] = T(1) - ccov1 - ccovmu
+          + ccov1*(T(1) - hsig[k])*ccumcov*(T(2) - ccumcov);
+    for(int i = 0; i < N; ++i)
+      for(int j = 0; j <= i; ++j)
+      {
+        T* Cij = C + tri(i, j)*lanes;
+        const T* pci = pc + i*lanes;
+        const T* pcj = pc + j*lanes;
+        for(int k = k0; k < k1; ++k)
+          Cij[k] = decay[k]*Cij[k] + ccov1*pci[k]*pcj[k];
+        for(int r = 0; r < mu; ++r)
+        {
+          const T f = ccovmu*w[r];
+          const T* yi = steps + ((size_t) r*N + i)*lanes;
+          const T* yj = steps + ((size_t) r*N + j)*lanes;
+          for(int k = k0; k < k1; ++k)
+            Cij[k] += f*yi[k]*yj[k];
+        }
+      }
+
+    // update of sigma
+    for(int k = k0; k < k1; ++k)
+      sigma[k] *= std::exp(((std::sqrt(psxps[k]) / chiN) - T(1))*cs
+          / params->damps);
+  }
+
+  /**
+   * Decomposes the covariance matrices of all instances, each thread on its
+   * share of instances, see laneRange(), and its own scratch matrix. The
+   * reduction to tridiagonal form runs on the whole share at once, see
+   * householderLanes().
+   */
+  void updateEigensystems()
+  {
+    NEURO_CMAES_TIME(eigen);
+    pool.parallelFor(0, pool.size(), [this](int first, int last)
+    {
+      for(int t = first; t < last; ++t)
+      {
+        int k0, k1;
+        laneRange(t, k0, k1);
+        if(k0 == k1)
+          continue;
+
+        // reduce all instances of the thread at once, B = C on input
+        for(int i = 0; i < N; ++i)
+          for(int j = 0; j <= i; ++j)
+          {
+            const T* Cij = C + tri(i, j)*lanes;
+            T* Bij = B + ((size_t) i*N + j)*lanes;
+            T* Bji = B + ((size_t) j*N + i)*lanes;
+            for(int k = k0; k < k1; ++k)
+              Bij[k] = Bji[k] = Cij[k];
+          }
+        householderLanes(B, rgD, eigenSub, eigenWork, N, lanes, k0, k1);
+
+        // the QL iterations differ between instances, so they run one
+        // instance at a time, with the eigenvectors in the rows of Qt
+        T** Qt = eigenRows + (size_t) t*N;
+        T* d = eigenValues + (size_t) t*N;
+        T* e = eigenTemp + (size_t) t*(N + 1);
+        for(int k = k0; k < k1; ++k)
+        {
+          for(int i = 0; i < N; ++i)
+          {
+            d[i] = rgD[i*lanes + k];
+            e[i] = eigenSub[i*lanes + k];
+            for(int j = 0; j < N; ++j)
+              Qt[j][i] = B[((size_t) i*N + j)*lanes + k];
+          }
+
+          qlTransposed(d, e, Qt, N);
+
+          minEW[k] = minElement(d, N);
+          maxEW[k] = maxElement(d, N);
+          for(int i = 0; i < N; ++i)
+          {
+            rgD[i*lanes + k] = std::sqrt(d[i]);
+            for(int j = 0; j < N; ++j)
+              B[((size_t) i*N + j)*lanes + k] = Qt[j][i];
+          }
+        }
+      }
+    });
+
+    eigensysIsUptodate = true;
+    genOfEigensysUpdate = gen;
+  }
+
+  /**
+   * Dirty index sort, see CMAES::sortIndex().
+   */
+  static void sortIndex(const T* rgFunVal, int* iindex, int n)
+  {
+    int i, j;
+    for(i = 1, iindex[0] = 0; i < n; ++i)
+    {
+      for(j = i; j > 0; --j)
+      {
+        if(rgFunVal[iindex[j - 1]] < rgFunVal[i])
+          break;
+        iindex[j] = iindex[j - 1];
+      }
+      iindex[j] = i;
+    }
+  }
+
+  //! Threads running the kernels.
+  ThreadPool pool;
+  //! Phase timings, only recorded if NEURO_CMAES_STATS is defined.
+  CMAESStats stats;
+  //! Parameters shared by all instances.
+  SharedParameters<T> params;
+  //! Owns all arrays below.
+  Arena arena;
+  //! One generator per instance, keyed by seed + k.
+  std::vector<CounterRandom<T> > rand;
+
+  //! Number of instances.
+  int K;
+  int N;
+  int lambda;
+  int mu;
+  //! Stride between consecutive elements of one instance, K padded.
+  int lanes;
+  //! Number of cache lines in one lane row.
+  int laneBlocks;
+  //! Row stride of the eigen scratch matrices.
+  int rowStride;
+  int historySize;
+
+  T chiN;
+  T dMaxSignifKond;
+  T gen;
+  T countevals;
+  T genOfEigensysUpdate;
+  bool eigensysIsUptodate;
+
+  //! Eigenvectors, element (i, j) of instance k at [(i*N + j)*lanes + k].
+  T* B;
+  //! Packed lower triangles, element (i, j) at [tri(i, j)*lanes + k].
+  T* C;
+  //! Offspring, element i of offspring l at [(l*N + i)*lanes + k].
+  T* population;
+  //! Scaled steps of the mu best offspring, laid out like population.
+  T* steps;
+  //! Offspring copied into contiguous vectors, returned to the user.
+  T** candidates;
+  //! Per thread scratch for the eigendecomposition.
+  T** eigenRows;
+  T* eigenValues;
+  T* eigenTemp;
+  //! Subdiagonals and scratch of householderLanes().
+  T* eigenSub;
+  T* eigenWork;
+
+  //! Vectors of length N per instance.
+  T* xmean;
+  T* xold;
+  T* pc;
+  T* ps;
+  T* rgD;
+  T* BDz;
+  T* z;
+
+  //! Scalars per instance.
+  T* acc;
+  T* sigma;
+  T* psxps;
+  T* decay;
+  T* hsig;
+  T* minEW;
+  T* maxEW;
+
+  T* publicFitness;
+  T* functionValues;
+  int* index;
+  T* funcValueHistory;
+  T* xBestEver;
+  T* bestFitness;
+};
+
+}  // namespace neuro_cmaes
+}  // namespace mlpack
+
+#endif  // MLPACK_METHODS_NEURO_CMAES_BATCH_CMAES_HPP
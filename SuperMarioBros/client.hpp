@@ -4,6 +4,9 @@
  *
  * Miscellaneous client routines.
  */
+#ifndef CLIENT_HPP
+#define CLIENT_HPP
+
 #include <mlpack/core.hpp>
 
 #include <string>
@@ -169,4 +172,6 @@ class Client {
   tcp::socket s;
 }; // class Client
 
-} // namespace client
\ No newline at end of file
+} // namespace client
+
+#endif
@@ -0,0 +1,128 @@
+/**
+ * @file cmaes_alloc_test.cpp
+ * @author www.github.com/Kartik-Nighania
+ *
+ * Checks that the generation loop of CMAES does not allocate once init()
+ * returned: every generation of samplePopulation(), evaluation,
+ * updateDistribution() and testForTermination() runs on the memory set up
+ * by init(). The global operator new is replaced by a counting one.
+ *
+ * Usage: cmaes_alloc_test
+ *
+ * Exits with 1 and names the failing case if any generation allocated or
+ * the engine stopped before minGenerations generations ran.
+ */
+
+#include <mlpack/core.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "neuro_cmaes.hpp"
+#include "parameters.hpp"
+
+namespace {
+
+//! Allocations while counting is on, from any thread.
+std::atomic<long> allocations(0);
+std::atomic<bool> counting(false);
+
+void* Allocate(const std::size_t size)
+{
+  if (counting)
+    ++allocations;
+
+  void* p = std::malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) { return Allocate(size); }
+void* operator new[](std::size_t size) { return Allocate(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+using namespace mlpack::neuro_cmaes;
+
+namespace {
+
+//! Sum of squares.
+double Sphere(const double* x, const int n)
+{
+  double sum = 0;
+  for (int i = 0; i < n; ++i)
+    sum += x[i] * x[i];
+  return sum;
+}
+
+//! Number of allocations in up to the given number of generations after
+//! init(); ran receives the number of generations that ran.
+long CountAllocations(const int dimension,
+                      const int threads,
+                      const int generations,
+                      int& ran)
+{
+  Parameters<double> parameters;
+  parameters.seed = 1;
+  parameters.numThreads = threads;
+  parameters.stopMaxIter = generations + 1;
+
+  std::vector<double> xstart(dimension, 3.0), stddev(dimension, 2.0);
+  parameters.init(dimension, xstart.data(), stddev.data());
+
+  CMAES<double> evo;
+  double* values = evo.init(std::move(parameters));
+
+  allocations = 0;
+  counting = true;
+  for (ran = 0; ran < generations && !evo.testForTermination(); ++ran)
+  {
+    double* const* population = evo.samplePopulation();
+    for (int i = 0; i < (int) evo.sampleSize(); ++i)
+      values[i] = Sphere(population[i], dimension);
+    evo.updateDistribution(values);
+  }
+  counting = false;
+
+  return allocations;
+}
+
+}  // namespace
+
+int main()
+{
+  const int dimensions[] = { 10, 100 };
+  const int threads[] = { 1, 4 };
+  const int generations = 50;
+  const int minGenerations = 40;
+
+  bool passed = true;
+  for (size_t d = 0; d < sizeof(dimensions) / sizeof(dimensions[0]); ++d)
+  {
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t)
+    {
+      int ran;
+      const long count = CountAllocations(dimensions[d], threads[t],
+          generations, ran);
+      std::printf("dimension %d, %d thread(s): %ld allocations in %d "
+          "generations\n", dimensions[d], threads[t], count, ran);
+      passed = passed && count == 0 && ran >= minGenerations;
+    }
+  }
+
+  if (!passed)
+  {
+    std::printf("FAILED: the generation loop allocated or ran fewer than %d "
+        "generations\n", minGenerations);
+    return 1;
+  }
+  return 0;
+}
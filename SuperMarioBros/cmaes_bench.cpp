@@ -0,0 +1,509 @@
+/**
+ * @file cmaes_bench.cpp
+ * @author www.github.com/Kartik-Nighania
+ *
+ * Benchmark of CMAES on standard test functions, to judge changes of the
+ * engine without the emulator.
+ *
+ * Usage: cmaes_bench [--functions sphere,ellipsoid,...] [--dimensions 10,100]
+ *                    [--lambdas 0,50] [--runs 1] [--seed 1] [--target 1e-8]
+ *                    [--max-generations 100000] [--max-seconds 60]
+ *                    [--threads 1] [--batch 0] [--format json|csv]
+ *
+ * A lambda of 0 uses the default population size. A batch of K > 0 runs K
+ * instances with seeds seed, ..., seed + K - 1 at once on BatchCMAES; such
+ * a run lasts until every instance met a stop criterion and reaches the
+ * target when every instance did. Every run reports the
+ * evaluations until the target fitness was reached (-1 if never), the wall
+ * time per generation and how it splits into the phases of a generation.
+ * The engine phases come from CMAES::statistics(), so this file is built
+ * with NEURO_CMAES_STATS.
+ */
+
+#include <mlpack/core.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "batch_cmaes.hpp"
+#include "neuro_cmaes.hpp"
+#include "parameters.hpp"
+
+using namespace mlpack::neuro_cmaes;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+//! Sum of squares.
+double Sphere(const double* x, const int n)
+{
+  double sum = 0;
+  for (int i = 0; i < n; ++i)
+    sum += x[i] * x[i];
+  return sum;
+}
+
+//! Axis parallel ellipsoid with condition number 1e6.
+double Ellipsoid(const double* x, const int n)
+{
+  double sum = 0;
+  for (int i = 0; i < n; ++i)
+    sum += std::pow(1e6, n > 1 ? i / (n - 1.0) : 0.0) * x[i] * x[i];
+  return sum;
+}
+
+//! Rosenbrock's banana function, minimum at (1, ..., 1).
+double Rosenbrock(const double* x, const int n)
+{
+  double sum = 0;
+  for (int i = 0; i < n - 1; ++i)
+  {
+    const double a = x[i] * x[i] - x[i + 1];
+    const double b = x[i] - 1;
+    sum += 100 * a * a + b * b;
+  }
+  return sum;
+}
+
+//! Multimodal Rastrigin function.
+double Rastrigin(const double* x, const int n)
+{
+  double sum = 10.0 * n;
+  for (int i = 0; i < n; ++i)
+    sum += x[i] * x[i] - 10 * std::cos(2 * M_PI * x[i]);
+  return sum;
+}
+
+//! One long axis: x0^2 + 1e6 * sum of the others.
+double Cigar(const double* x, const int n)
+{
+  double sum = 0;
+  for (int i = 1; i < n; ++i)
+    sum += x[i] * x[i];
+  return x[0] * x[0] + 1e6 * sum;
+}
+
+//! One short axis: 1e6 * x0^2 + sum of the others.
+double Discus(const double* x, const int n)
+{
+  double sum = 0;
+  for (int i = 1; i < n; ++i)
+    sum += x[i] * x[i];
+  return 1e6 * x[0] * x[0] + sum;
+}
+
+struct TestFunction
+{
+  const char* name;
+  double (*evaluate)(const double*, int);
+};
+
+const TestFunction testFunctions[] = {
+  { "sphere", Sphere },
+  { "ellipsoid", Ellipsoid },
+  { "rosenbrock", Rosenbrock },
+  { "rastrigin", Rastrigin },
+  { "cigar", Cigar },
+  { "discus", Discus }
+};
+
+struct Options
+{
+  std::vector<std::string> functions;
+  std::vector<int> dimensions;
+  std::vector<int> lambdas;
+  int runs;
+  unsigned long seed;
+  double target;
+  int maxGenerations;
+  double maxSeconds;
+  int threads;
+  int batch;
+  bool csv;
+};
+
+//! Measurements of a single run.
+struct Result
+{
+  std::string function;
+  int dimension;
+  int lambda;
+  unsigned long seed;
+  //! Instances run at once, 1 unless --batch is given.
+  int instances;
+  double evaluationsToTarget;
+  double evaluations;
+  int generations;
+  double best;
+  std::string stop;
+
+  //! Engine phases, summed over all generations.
+  CMAESStats phases;
+  //! Seconds spent in the objective function and in the whole run.
+  double evaluate;
+  double total;
+};
+
+double Seconds(const Clock::time_point& begin, const Clock::time_point& end)
+{
+  return std::chrono::duration<double>(end - begin).count();
+}
+
+Result Run(const TestFunction& function,
+           const int dimension,
+           const int lambda,
+           const unsigned long seed,
+           const Options& options)
+{
+  Parameters<double> parameters;
+  if (lambda > 0)
+    parameters.lambda = lambda;
+  parameters.seed = seed;
+  parameters.numThreads = options.threads;
+  parameters.stopMaxFunEvals = 1e15;
+  parameters.stopMaxIter = options.maxGenerations;
+  parameters.stStopFitness.flg = true;
+  parameters.stStopFitness.val = options.target;
+
+  std::vector<double> xstart(dimension, 3.0), stddev(dimension, 2.0);
+  parameters.init(dimension, xstart.data(), stddev.data());
+
+  CMAES<double> evo;
+  double* values = evo.init(std::move(parameters));
+
+  Result result;
+  result.function = function.name;
+  result.dimension = dimension;
+  result.lambda = (int) evo.sampleSize();
+  result.seed = seed;
+  result.instances = 1;
+  result.evaluationsToTarget = -1;
+  result.evaluate = 0;
+
+  const Clock::time_point start = Clock::now();
+  while (!evo.testForTermination())
+  {
+    if (Seconds(start, Clock::now()) > options.maxSeconds)
+    {
+      result.stop = "MaxSeconds";
+      break;
+    }
+
+    double* const* population = evo.samplePopulation();
+    const Clock::time_point t0 = Clock::now();
+    for (int i = 0; i < result.lambda; ++i)
+      values[i] = function.evaluate(population[i], dimension);
+    result.evaluate += Seconds(t0, Clock::now());
+    evo.updateDistribution(values);
+
+    if (result.evaluationsToTarget < 0 && evo.fitness() <= options.target)
+      result.evaluationsToTarget = evo.evaluation();
+  }
+  result.total = Seconds(start, Clock::now());
+
+  if (result.stop.empty())
+  {
+    // First matched criterion, e.g. "Fitness" or "MaxIter".
+    const std::string message = evo.getStopMessage();
+    result.stop = message.substr(0, message.find(':'));
+  }
+  result.phases = evo.statistics();
+  result.evaluations = evo.evaluation();
+  result.generations = (int) evo.generation();
+  result.best = evo.fitnessBestEver();
+  return result;
+}
+
+/**
+ * Runs options.batch instances on BatchCMAES. The evaluations and the best
+ * fitness are those of the slowest instance; the instances that stopped
+ * early keep being sampled and updated with the others.
+ */
+Result RunBatch(const TestFunction& function,
+                const int dimension,
+                const int lambda,
+                const unsigned long seed,
+                const Options& options)
+{
+  Parameters<double> parameters;
+  if (lambda > 0)
+    parameters.lambda = lambda;
+  parameters.stopMaxFunEvals = 1e15;
+  parameters.stopMaxIter = options.maxGenerations;
+  parameters.stStopFitness.flg = true;
+  parameters.stStopFitness.val = options.target;
+
+  std::vector<double> xstart(dimension, 3.0), stddev(dimension, 2.0);
+  parameters.init(dimension, xstart.data(), stddev.data());
+
+  BatchCMAES<double> evo(options.threads);
+  double* values = evo.init(parameters, options.batch, seed);
+  const int instances = evo.instances();
+
+  Result result;
+  result.function = function.name;
+  result.dimension = dimension;
+  result.lambda = (int) evo.sampleSize();
+  result.seed = seed;
+  result.instances = instances;
+  result.evaluationsToTarget = -1;
+  result.evaluate = 0;
+
+  std::vector<bool> stopped(instances, false);
+  int running = instances;
+  double termination = 0;
+  const Clock::time_point start = Clock::now();
+  while (running > 0)
+  {
+    if (Seconds(start, Clock::now()) > options.maxSeconds)
+    {
+      result.stop = "MaxSeconds";
+      break;
+    }
+
+    double* const* population = evo.samplePopulation();
+    const Clock::time_point t0 = Clock::now();
+    for (int i = 0; i < instances * result.lambda; ++i)
+      values[i] = function.evaluate(population[i], dimension);
+    result.evaluate += Seconds(t0, Clock::now());
+    evo.updateDistribution(values);
+
+    const Clock::time_point t1 = Clock::now();
+    bool reached = true;
+    for (int k = 0; k < instances; ++k)
+    {
+      if (!stopped[k] && evo.testForTermination(k))
+      {
+        stopped[k] = true;
+        --running;
+      }
+      reached = reached && evo.fitnessBestEver(k) <= options.target;
+    }
+    termination += Seconds(t1, Clock::now());
+
+    if (result.evaluationsToTarget < 0 && reached)
+      result.evaluationsToTarget = evo.evaluation();
+  }
+  result.total = Seconds(start, Clock::now());
+
+  if (result.stop.empty())
+    result.stop = "AllInstances";
+  result.phases = evo.statistics();
+  result.phases.termination.total = termination;
+  result.evaluations = evo.evaluation();
+  result.generations = (int) evo.generation();
+  result.best = evo.fitnessBestEver(0);
+  for (int k = 1; k < instances; ++k)
+    result.best = std::max(result.best, evo.fitnessBestEver(k));
+  return result;
+}
+
+//! Milliseconds per generation.
+double PerGeneration(const double seconds, const Result& result)
+{
+  return result.generations ? 1e3 * seconds / result.generations : 0;
+}
+
+//! The engine phases in output order.
+struct Phase
+{
+  const char* name;
+  PhaseStats CMAESStats::*stats;
+};
+
+const Phase phases[] = {
+  { "eigen", &CMAESStats::eigen },
+  { "sample", &CMAESStats::sample },
+  { "sort", &CMAESStats::sort },
+  { "mean", &CMAESStats::mean },
+  { "adapt_c", &CMAESStats::adaptC2 },
+  { "min_std_devs", &CMAESStats::minStdDevs },
+  { "termination", &CMAESStats::termination }
+};
+
+const size_t numPhases = sizeof(phases) / sizeof(phases[0]);
+
+void PrintCSVHeader()
+{
+  std::printf("function,dimension,lambda,seed,instances,"
+      "evaluations_to_target,evaluations,generations,best,stop,generation_ms");
+  for (size_t i = 0; i < numPhases; ++i)
+    std::printf(",%s_ms", phases[i].name);
+  std::printf(",evaluate_ms\n");
+}
+
+void PrintCSV(const Result& r)
+{
+  std::printf("%s,%d,%d,%lu,%d,%.0f,%.0f,%d,%.6e,%s,%.6f",
+      r.function.c_str(), r.dimension, r.lambda, r.seed, r.instances,
+      r.evaluationsToTarget, r.evaluations, r.generations, r.best,
+      r.stop.c_str(), PerGeneration(r.total, r));
+  for (size_t i = 0; i < numPhases; ++i)
+    std::printf(",%.6f", PerGeneration((r.phases.*phases[i].stats).total, r));
+  std::printf(",%.6f\n", PerGeneration(r.evaluate, r));
+}
+
+void PrintJSON(const Result& r, const bool first)
+{
+  std::printf("%s\n  {\"function\": \"%s\", \"dimension\": %d, "
+      "\"lambda\": %d, \"seed\": %lu, \"instances\": %d, "
+      "\"evaluations_to_target\": %.0f, \"evaluations\": %.0f, "
+      "\"generations\": %d, \"best\": %.6e, "
+      "\"stop\": \"%s\", \"generation_ms\": %.6f, \"phases_ms\": {",
+      first ? "" : ",", r.function.c_str(), r.dimension, r.lambda, r.seed,
+      r.instances, r.evaluationsToTarget, r.evaluations, r.generations,
+      r.best, r.stop.c_str(), PerGeneration(r.total, r));
+  for (size_t i = 0; i < numPhases; ++i)
+  {
+    std::printf("\"%s\": %.6f, ", phases[i].name,
+        PerGeneration((r.phases.*phases[i].stats).total, r));
+  }
+  std::printf("\"evaluate\": %.6f}}", PerGeneration(r.evaluate, r));
+}
+
+std::vector<std::string> Split(const std::string& list)
+{
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ','))
+  {
+    if (!item.empty())
+      items.push_back(item);
+  }
+  return items;
+}
+
+std::vector<int> SplitInts(const std::string& list)
+{
+  std::vector<int> values;
+  const std::vector<std::string> items = Split(list);
+  for (size_t i = 0; i < items.size(); ++i)
+    values.push_back(std::atoi(items[i].c_str()));
+  return values;
+}
+
+void Usage(const char* name)
+{
+  std::cerr << "Usage: " << name << " [--functions sphere,ellipsoid,"
+      << "rosenbrock,rastrigin,cigar,discus] [--dimensions 10,100,1000] "
+      << "[--lambdas 0] [--runs 1] [--seed 1] [--target 1e-8] "
+      << "[--max-generations 100000] [--max-seconds 60] [--threads 1] "
+      << "[--batch 0] [--format json|csv]"
+      << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  Options options;
+  options.functions = Split("sphere,ellipsoid,rosenbrock,rastrigin,cigar,"
+      "discus");
+  options.dimensions = SplitInts("10,30,100,300,1000,2000");
+  options.lambdas = SplitInts("0");
+  options.runs = 1;
+  options.seed = 1;
+  options.target = 1e-8;
+  options.maxGenerations = 100000;
+  options.maxSeconds = 60;
+  options.threads = 1;
+  options.batch = 0;
+  options.csv = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string option(argv[i]);
+    if (i + 1 >= argc)
+    {
+      Usage(argv[0]);
+      return 1;
+    }
+
+    const std::string value(argv[++i]);
+    if (option == "--functions")
+      options.functions = Split(value);
+    else if (option == "--dimensions")
+      options.dimensions = SplitInts(value);
+    else if (option == "--lambdas")
+      options.lambdas = SplitInts(value);
+    else if (option == "--runs")
+      options.runs = std::atoi(value.c_str());
+    else if (option == "--seed")
+      options.seed = std::strtoul(value.c_str(), NULL, 10);
+    else if (option == "--target")
+      options.target = std::atof(value.c_str());
+    else if (option == "--max-generations")
+      options.maxGenerations = std::atoi(value.c_str());
+    else if (option == "--max-seconds")
+      options.maxSeconds = std::atof(value.c_str());
+    else if (option == "--threads")
+      options.threads = std::atoi(value.c_str());
+    else if (option == "--batch")
+      options.batch = std::atoi(value.c_str());
+    else if (option == "--format")
+      options.csv = value == "csv";
+    else
+    {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (options.csv)
+    PrintCSVHeader();
+  else
+    std::printf("[");
+
+  bool first = true;
+  for (size_t f = 0; f < options.functions.size(); ++f)
+  {
+    const TestFunction* function = NULL;
+    for (size_t i = 0; i < sizeof(testFunctions) / sizeof(testFunctions[0]);
+        ++i)
+    {
+      if (options.functions[f] == testFunctions[i].name)
+        function = &testFunctions[i];
+    }
+    if (!function)
+    {
+      std::cerr << "Unknown function: " << options.functions[f] << std::endl;
+      return 1;
+    }
+
+    for (size_t d = 0; d < options.dimensions.size(); ++d)
+    {
+      for (size_t l = 0; l < options.lambdas.size(); ++l)
+      {
+        for (int run = 0; run < options.runs; ++run)
+        {
+          const Result result = options.batch > 0 ?
+              RunBatch(*function, options.dimensions[d], options.lambdas[l],
+                  options.seed + run * options.batch, options) :
+              Run(*function, options.dimensions[d], options.lambdas[l],
+                  options.seed + run, options);
+          if (options.csv)
+            PrintCSV(result);
+          else
+            PrintJSON(result, first);
+          first = false;
+          std::fflush(stdout);
+        }
+      }
+    }
+  }
+
+  if (!options.csv)
+    std::printf("\n]\n");
+
+  return 0;
+}
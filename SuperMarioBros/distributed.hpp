@@ -0,0 +1,862 @@
+/**
+ * @file distributed.hpp
+ * @author www.github.com/Kartik-Nighania
+ *
+ * Master and worker to evaluate the candidates of one optimizer on many
+ * hosts.
+ */
+#ifndef DISTRIBUTED_HPP
+#define DISTRIBUTED_HPP
+
+#include <mlpack/core.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+#include <boost/asio.hpp>
+
+#include "parser.hpp"
+#include "client.hpp"
+#include "messages.hpp"
+
+namespace distributed {
+
+using boost::asio::ip::tcp;
+
+/**
+ * The master hands out the candidates of one generation to the connected
+ * workers and gathers their fitness.
+ *
+ * Workers connect with client::Client, register, and then repeatedly request
+ * a task and send back its result. Every message refreshes the worker, and
+ * workers send heartbeats while they evaluate. If a worker is silent for
+ * longer than the heartbeat timeout, its unfinished tasks are put back into
+ * the queue and handed to the next worker that asks. The first result that
+ * arrives for a task wins.
+ *
+ * Candidates are either sent as vectors or, to workers that registered with
+ * a replica of the optimizer, only as (generation, index). Such a worker samples the
+ * candidate itself and replays the generations it missed from the fitness
+ * values kept by the master, so only seeds and fitness values cross the
+ * network. The master keeps the fitness values of every generation, lambda
+ * doubles each, for the whole run, and sends them to a worker that catches
+ * up historyRange generations per message.
+ *
+ * Shutdown() waits until every live worker was told to stop. The destructor
+ * closes the connections and joins all threads of the master.
+ */
+class Master
+{
+ public:
+  /**
+   * Start listening for workers on the given port.
+   *
+   * @param port The port the workers connect to.
+   * @param heartbeatTimeout Seconds without a message after which a worker
+   *        is considered lost.
+   */
+  Master(const size_t port, const double heartbeatTimeout = 30) :
+      acceptor(ioService, tcp::endpoint(tcp::v4(), port)),
+      heartbeatTimeout(heartbeatTimeout),
+      nextWorkerId(0),
+      generation(0),
+      population(NULL),
+      fitness(NULL),
+      dimension(0),
+      sampled(false),
+      remaining(0),
+      stopping(false),
+      closing(false)
+  {
+    server = std::thread(&Master::Serve, this);
+  }
+
+  /**
+   * Stop accepting workers, close their connections and wait for the
+   * threads that served them.
+   */
+  ~Master()
+  {
+    boost::system::error_code error;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      closing = true;
+      for (Connection& connection : connections)
+      {
+        connection.socket->shutdown(tcp::socket::shutdown_both, error);
+      }
+    }
+
+    // Serve() blocks in accept(), wake it up with a connection of our own.
+    tcp::socket wake(ioService);
+    wake.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(),
+        acceptor.local_endpoint().port()), error);
+    server.join();
+    acceptor.close(error);
+
+    for (Connection& connection : connections)
+    {
+      connection.thread.join();
+    }
+  }
+
+  /**
+   * Evaluate all candidates on the workers and block until every fitness
+   * value arrived.
+   *
+   * @param candidates The lambda candidate solutions.
+   * @param lambda The number of candidates.
+   * @param n The dimension of each candidate.
+   * @param values Array of lambda values that receives the fitness.
+   */
+  void Evaluate(double const* const* candidates,
+                const int lambda,
+                const int n,
+                double* values)
+  {
+    Dispatch(candidates, lambda, n, values, false);
+  }
+
+  /**
+   * Evaluate all candidates on workers that sample them from their replica
+   * of the optimizer, and block until every fitness value arrived. The
+   * replicas must use the same parameters, including the seed, and every
+   * generation of the optimizer has to be evaluated with this method.
+   * Workers without a replica get the candidates as vectors, or are turned
+   * away if no candidates are given.
+   *
+   * @param lambda The number of candidates.
+   * @param values Array of lambda values that receives the fitness.
+   * @param candidates The lambda candidate solutions, or NULL.
+   * @param n The dimension of each candidate.
+   */
+  void Evaluate(const int lambda,
+                double* values,
+                double const* const* candidates = NULL,
+                const int n = 0)
+  {
+    Dispatch(candidates, lambda, n, values, true);
+  }
+
+  /**
+   * Tell all workers to shut down on their next request, and block until
+   * every live worker got the message or was lost. Workers in the middle of
+   * an evaluation keep sending heartbeats, so they are waited for.
+   */
+  void Shutdown()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    stopping = true;
+    while (!lastSeen.empty())
+    {
+      finished.wait_for(lock, std::chrono::seconds(1));
+      ReassignLostWork();
+    }
+  }
+
+  //! Most generations of fitness values sent to a worker in one message.
+  static const int historyRange = 100;
+
+  //! Get the number of workers that are currently alive.
+  size_t NumWorkers()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lastSeen.size();
+  }
+
+ private:
+  //! A worker connection and the thread that answers it.
+  struct Connection
+  {
+    std::shared_ptr<tcp::socket> socket;
+    std::thread thread;
+    bool finished;
+  };
+
+  //! Queue the candidates of the next generation and wait for their fitness.
+  void Dispatch(double const* const* candidates,
+                const int lambda,
+                const int n,
+                double* values,
+                const bool sampledTasks)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    ++generation;
+    sampled = sampledTasks;
+    population = candidates;
+    fitness = values;
+    dimension = n;
+    remaining = lambda;
+    owner.assign(lambda, -1);
+    done.assign(lambda, false);
+    queue.clear();
+    for (int i = 0; i < lambda; ++i)
+    {
+      queue.push_back(i);
+    }
+
+    while (remaining > 0)
+    {
+      finished.wait_for(lock, std::chrono::seconds(1));
+      ReassignLostWork();
+    }
+
+    history.push_back(std::vector<double>(values, values + lambda));
+    population = NULL;
+    fitness = NULL;
+  }
+
+  //! Accept worker connections, one thread per connection, until the
+  //! master is destroyed.
+  void Serve()
+  {
+    for (;;)
+    {
+      std::shared_ptr<tcp::socket> socket(new tcp::socket(ioService));
+      boost::system::error_code error;
+      acceptor.accept(*socket, error);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (closing)
+      {
+        return;
+      }
+
+      if (error)
+      {
+        mlpack::Log::Warn << "Accept failed: " << error.message() << std::endl;
+        continue;
+      }
+
+      // Join the threads of the connections that were closed.
+      for (auto it = connections.begin(); it != connections.end(); )
+      {
+        if (!it->finished)
+        {
+          ++it;
+          continue;
+        }
+
+        it->thread.join();
+        it = connections.erase(it);
+      }
+
+      connections.push_back(Connection());
+      Connection& connection = connections.back();
+      connection.socket = socket;
+      connection.finished = false;
+      connection.thread = std::thread(&Master::Session, this, &connection);
+    }
+  }
+
+  //! Answer the messages of one connection until it is closed.
+  void Session(Connection* connection)
+  {
+    tcp::socket& socket = *connection->socket;
+    try
+    {
+      boost::asio::streambuf buffer;
+      std::istream stream(&buffer);
+      for (;;)
+      {
+        boost::asio::read_until(socket, buffer, "\r\n");
+
+        std::string message;
+        std::getline(stream, message);
+        boost::trim(message);
+        if (message.empty()) continue;
+
+        int stoppedWorker = -1;
+        const std::string reply = messages::JSONMessage(
+            Handle(message, stoppedWorker)) + "\r\n\r\n\r\n";
+        boost::asio::write(socket, boost::asio::buffer(reply));
+
+        // The worker is gone once the stop message was written, not before,
+        // or Shutdown() could return and the destructor close the socket
+        // while the message is still unsent.
+        if (stoppedWorker >= 0)
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          lastSeen.erase(stoppedWorker);
+          finished.notify_all();
+        }
+      }
+    }
+    catch (const std::exception& ex)
+    {
+      // The worker or the destructor closed the connection; lost tasks are
+      // handled by the heartbeat timeout.
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    connection->finished = true;
+  }
+
+  //! Handle a single message and return the reply. If the reply tells the
+  //! worker to stop, its id is stored in stoppedWorker.
+  std::string Handle(const std::string& message, int& stoppedWorker)
+  {
+    parser::Parser parser;
+    std::string type;
+    int worker, resultGeneration, index;
+    double value;
+    try
+    {
+      parser.Parse(message);
+      type = parser.Type();
+      if (type == "result")
+      {
+        parser.Result(worker, resultGeneration, index, value);
+      }
+      else if (type != "register")
+      {
+        parser.Sender(worker);
+      }
+    }
+    catch (const std::exception& ex)
+    {
+      // A lost result is put back into the queue once its worker requests
+      // the next task.
+      mlpack::Log::Warn << "Invalid message: " << ex.what() << std::endl;
+      return messages::Ack();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (type == "register")
+    {
+      bool replica;
+      parser.Register(replica);
+
+      const int id = nextWorkerId++;
+      Seen(id);
+      if (replica)
+      {
+        replicas.insert(id);
+      }
+      mlpack::Log::Info << "Worker " << id << " registered." << std::endl;
+      return messages::WorkerId(id);
+    }
+
+    if (type == "result")
+    {
+      Seen(worker);
+
+      if (resultGeneration == generation && fitness && index >= 0 &&
+          index < (int) done.size() && !done[index])
+      {
+        fitness[index] = value;
+        done[index] = true;
+        owner[index] = -1;
+        if (--remaining == 0)
+        {
+          finished.notify_all();
+        }
+      }
+      return messages::Ack();
+    }
+
+    Seen(worker);
+
+    if (type == "heartbeat")
+    {
+      return messages::Ack();
+    }
+
+    if (type == "history")
+    {
+      int past;
+      parser.History(past);
+      if (past < 1 || past > (int) history.size())
+      {
+        return messages::Wait();
+      }
+      const int available = history.size() - past + 1;
+      const int count = available < historyRange ? available : historyRange;
+      return messages::Fitness(past, &history[past - 1], count);
+    }
+
+    if (stopping)
+    {
+      // Stop refreshing the worker; Session() drops it once the message is
+      // written, or the heartbeat timeout does if the write fails.
+      stopped.insert(worker);
+      stoppedWorker = worker;
+      return messages::Stop();
+    }
+
+    // Workers without a replica need the candidates themselves.
+    const bool seedTask = sampled && replicas.count(worker);
+    if (type == "request" && fitness && !seedTask && !population)
+    {
+      mlpack::Log::Warn << "Worker " << worker << " has no replica of the "
+          << "optimizer, rejecting it." << std::endl;
+      stopped.insert(worker);
+      stoppedWorker = worker;
+      return messages::Reject("The master only sends sampled tasks, which "
+          "require a replica of the optimizer.");
+    }
+
+    // A worker evaluates one task at a time, so a task it still owns when
+    // it requests the next one lost its result on the way.
+    if (type == "request")
+    {
+      for (size_t i = 0; i < owner.size(); ++i)
+      {
+        if (owner[i] == worker && !done[i])
+        {
+          mlpack::Log::Warn << "Result of task " << i << " from worker "
+              << worker << " lost, reassigning it." << std::endl;
+          owner[i] = -1;
+          queue.push_front(i);
+        }
+      }
+    }
+
+    // Skip tasks that were reassigned and finished in the meantime.
+    while (!queue.empty() && done[queue.front()])
+    {
+      queue.pop_front();
+    }
+
+    if (type != "request" || queue.empty() || !fitness)
+    {
+      return messages::Wait();
+    }
+
+    index = queue.front();
+    queue.pop_front();
+    owner[index] = worker;
+    if (seedTask)
+    {
+      return messages::SeedTask(generation, index);
+    }
+    return messages::Task(generation, index, population[index], dimension);
+  }
+
+  //! Refresh a worker that sent a message, unless it was told to stop.
+  void Seen(const int worker)
+  {
+    if (!stopped.count(worker))
+    {
+      lastSeen[worker] = Clock::now();
+    }
+  }
+
+  //! Put the unfinished tasks of lost workers back into the queue.
+  void ReassignLostWork()
+  {
+    const Clock::time_point now = Clock::now();
+    for (auto it = lastSeen.begin(); it != lastSeen.end(); )
+    {
+      if (std::chrono::duration<double>(now - it->second).count() <
+          heartbeatTimeout)
+      {
+        ++it;
+        continue;
+      }
+
+      mlpack::Log::Warn << "Worker " << it->first << " lost." << std::endl;
+      for (size_t i = 0; i < owner.size(); ++i)
+      {
+        if (owner[i] == it->first && !done[i])
+        {
+          owner[i] = -1;
+          queue.push_front(i);
+        }
+      }
+      it = lastSeen.erase(it);
+    }
+  }
+
+  typedef std::chrono::steady_clock Clock;
+
+  //! Locally stored io service.
+  boost::asio::io_service ioService;
+
+  //! Locally stored acceptor for worker connections.
+  tcp::acceptor acceptor;
+
+  //! Seconds without a message after which a worker is lost.
+  double heartbeatTimeout;
+
+  //! Thread that accepts the worker connections.
+  std::thread server;
+
+  //! Protects all members below.
+  std::mutex mutex;
+
+  //! Signaled when the last result of a generation arrived.
+  std::condition_variable finished;
+
+  //! Time of the last message of every live worker.
+  std::map<int, Clock::time_point> lastSeen;
+
+  //! Id of the next worker that registers.
+  int nextWorkerId;
+
+  //! Generation that is currently evaluated.
+  int generation;
+
+  //! Fitness values of all finished generations.
+  std::vector<std::vector<double> > history;
+
+  //! Candidates and fitness values of the current generation, population is
+  //! NULL if only workers with a replica can evaluate them.
+  double const* const* population;
+  double* fitness;
+  int dimension;
+
+  //! Whether workers with a replica sample the candidates themselves.
+  bool sampled;
+
+  //! Workers that registered with a replica of the optimizer.
+  std::set<int> replicas;
+
+  //! Number of candidates without fitness.
+  int remaining;
+
+  //! Tasks that are not assigned to any worker.
+  std::deque<int> queue;
+
+  //! Worker that evaluates a task, -1 if none.
+  std::vector<int> owner;
+
+  //! Whether the fitness of a task arrived.
+  std::vector<bool> done;
+
+  //! Set to true to stop the workers.
+  bool stopping;
+
+  //! Workers that were told to stop.
+  std::set<int> stopped;
+
+  //! Open connections; the closed ones are removed by Serve().
+  std::list<Connection> connections;
+
+  //! Set by the destructor to stop accepting connections.
+  bool closing;
+};
+
+/**
+ * A worker connects to the master, evaluates the tasks it hands out and
+ * sends back their fitness. A second connection sends heartbeats, so that
+ * long evaluations are not mistaken for a lost worker.
+ */
+class Worker
+{
+ public:
+  /**
+   * Create the worker for the given master.
+   *
+   * @param host The hostname of the master.
+   * @param port The port of the master.
+   * @param heartbeatInterval Seconds between two heartbeats.
+   * @param maxFailures Connections in a row that may fail, 5 seconds apart,
+   *        before the worker assumes the master is gone and stops.
+   */
+  Worker(const std::string& host,
+         const std::string& port,
+         const double heartbeatInterval = 5,
+         const int maxFailures = 12) :
+      host(host),
+      port(port),
+      heartbeatInterval(heartbeatInterval),
+      maxFailures(maxFailures),
+      id(-1),
+      fetchedFirst(0),
+      running(false)
+  {
+    /* Nothing to do here */
+  }
+
+  /**
+   * Evaluate tasks until the master tells the worker to stop. Lost
+   * connections are reestablished, up to maxFailures times in a row. The
+   * worker registers without a replica, so the master sends it the
+   * candidates themselves, or turns it away if it has none to send.
+   *
+   * @param function Called as function(x) for every task, must return the
+   *        fitness of the candidate x.
+   */
+  template<typename FunctionType>
+  void Run(FunctionType& function)
+  {
+    std::vector<double> x;
+    auto evaluate = [&](client::Client&, int& generation, int& index)
+    {
+      parser.Task(generation, index, x);
+      return function(x);
+    };
+
+    Process(evaluate, false);
+  }
+
+  /**
+   * Evaluate tasks until the master tells the worker to stop, sampling the
+   * candidates with a replica of the optimizer of the master. Lost
+   * connections are reestablished, up to maxFailures times in a row.
+   *
+   * @param replica Optimizer initialized with the same parameters and seed
+   *        as the one of the master, and not used otherwise.
+   * @param function Called as function(x) for every task, must return the
+   *        fitness of the candidate x.
+   */
+  template<typename OptimizerType, typename FunctionType>
+  void Run(OptimizerType& replica, FunctionType& function)
+  {
+    // Number of generations sampled and updated by the replica.
+    int sampled = 0, updated = 0;
+    decltype(replica.samplePopulation()) population = NULL;
+
+    std::vector<double> x, values;
+    auto evaluate = [&](client::Client& client, int& generation, int& index)
+    {
+      if (parser.Type() == "task")
+      {
+        parser.Task(generation, index, x);
+        return function(x);
+      }
+
+      parser.SeedTask(generation, index);
+
+      // Catch up with the master, using the fitness values of the
+      // generations in between.
+      while (updated < generation - 1)
+      {
+        if (sampled == updated)
+        {
+          population = replica.samplePopulation();
+          ++sampled;
+        }
+
+        FetchFitness(client, updated + 1, values);
+        replica.updateDistribution(values.data());
+        ++updated;
+      }
+
+      if (sampled < generation)
+      {
+        population = replica.samplePopulation();
+        ++sampled;
+      }
+
+      x.assign(population[index], population[index] +
+          (int) replica.dimension());
+      return function(x);
+    };
+
+    Process(evaluate, true);
+  }
+
+ private:
+  /**
+   * Request and evaluate tasks until the master tells the worker to stop or
+   * cannot be reached maxFailures times in a row.
+   *
+   * @param evaluate Called as evaluate(client, generation, index) for the
+   *        task in the parser, sets the generation and index of the task and
+   *        returns its fitness.
+   * @param replica Whether evaluate can sample tasks with a replica of the
+   *        optimizer.
+   */
+  template<typename EvaluationType>
+  void Process(EvaluationType& evaluate, const bool replica)
+  {
+    for (int failures = 0; ; )
+    {
+      try
+      {
+        client::Client client;
+        client.Connect(host, port);
+
+        std::string json;
+        client.Send(messages::JSONMessage(messages::RegisterWorker(
+            boost::asio::ip::host_name(), replica)));
+        client.Receive(json);
+        parser.Parse(json);
+        parser.WorkerId(id);
+        failures = 0;
+
+        HeartbeatGuard heartbeat(*this);
+
+        for (;;)
+        {
+          client.Send(messages::JSONMessage(messages::RequestTask(id)));
+          client.Receive(json);
+          parser.Parse(json);
+
+          const std::string type = parser.Type();
+          if (type == "stop")
+          {
+            return;
+          }
+          else if (type == "reject")
+          {
+            std::string reason;
+            parser.Reject(reason);
+            mlpack::Log::Warn << "Rejected by the master: " << reason
+                << std::endl;
+            return;
+          }
+          else if (type != "task" && type != "seedtask")
+          {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            continue;
+          }
+
+          int generation, index;
+          const double fitness = evaluate(client, generation, index);
+
+          client.Send(messages::JSONMessage(messages::Result(id, generation,
+              index, fitness)));
+          client.Receive(json);
+        }
+      }
+      catch (const std::exception& ex)
+      {
+        mlpack::Log::Warn << ex.what() << std::endl;
+      }
+      catch (...)
+      {
+        mlpack::Log::Warn << "Connection to the master lost." << std::endl;
+      }
+
+      if (++failures >= maxFailures)
+      {
+        mlpack::Log::Warn << "Master unreachable, stopping." << std::endl;
+        return;
+      }
+      std::this_thread::sleep_for(std::chrono::seconds(5));
+    }
+  }
+
+  //! Get the fitness values of a past generation, from the generations
+  //! fetched last or else from the master, which sends the following
+  //! generations along.
+  void FetchFitness(client::Client& client,
+                    const int generation,
+                    std::vector<double>& values)
+  {
+    std::string json;
+    while (generation < fetchedFirst ||
+           generation >= fetchedFirst + (int) fetched.size())
+    {
+      client.Send(messages::JSONMessage(messages::History(id, generation)));
+      client.Receive(json);
+      parser.Parse(json);
+
+      if (parser.Type() == "fitness")
+      {
+        parser.Fitness(fetchedFirst, fetched);
+        if (fetchedFirst == generation && !fetched.empty()) break;
+      }
+
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    values = fetched[generation - fetchedFirst];
+  }
+
+  //! Runs the heartbeat thread for the lifetime of a connection.
+  struct HeartbeatGuard
+  {
+    HeartbeatGuard(Worker& worker) : worker(worker)
+    {
+      worker.running = true;
+      thread = std::thread(&Worker::Heartbeat, &worker);
+    }
+
+    ~HeartbeatGuard()
+    {
+      {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.running = false;
+      }
+      worker.wake.notify_all();
+      thread.join();
+    }
+
+    Worker& worker;
+    std::thread thread;
+  };
+
+  //! Send a heartbeat every heartbeatInterval seconds while running.
+  void Heartbeat()
+  {
+    const int workerId = id;
+    std::unique_ptr<client::Client> client;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running)
+    {
+      lock.unlock();
+      try
+      {
+        if (!client)
+        {
+          client.reset(new client::Client());
+          client->Connect(host, port);
+        }
+
+        std::string json;
+        client->Send(messages::JSONMessage(messages::Heartbeat(workerId)));
+        client->Receive(json);
+      }
+      catch (...)
+      {
+        client.reset();
+      }
+      lock.lock();
+
+      wake.wait_for(lock, std::chrono::duration<double>(heartbeatInterval),
+          [this] { return !running; });
+    }
+  }
+
+  //! Locally stored master host name.
+  std::string host;
+
+  //! Locally stored master port.
+  std::string port;
+
+  //! Seconds between two heartbeats.
+  double heartbeatInterval;
+
+  //! Failed connections in a row before the worker stops.
+  int maxFailures;
+
+  //! Id assigned by the master.
+  int id;
+
+  //! Fitness values of the generations fetched last, starting with
+  //! generation fetchedFirst.
+  int fetchedFirst;
+  std::vector<std::vector<double> > fetched;
+
+  //! Locally stored parser instance.
+  parser::Parser parser;
+
+  //! Whether the heartbeat thread should keep running.
+  bool running;
+
+  //! Protects running.
+  std::mutex mutex;
+
+  //! Wakes up the heartbeat thread.
+  std::condition_variable wake;
+};
+
+} // namespace distributed
+
+#endif
@@ -0,0 +1,276 @@
+#ifndef MLPACK_METHODS_NEURO_CMAES_FROZEN_GENOME_HPP
+#define MLPACK_METHODS_NEURO_CMAES_FROZEN_GENOME_HPP
+
+/**
+ * @file frozen_genome.hpp
+ * @author www.github.com/Kartik-Nighania
+ *
+ * A genome frozen for inference with float32 or int8 weights.
+ */
+
+#include <cstddef>
+#include <cassert>
+#include <cmath>
+#include <vector>
+#include <stdint.h>
+
+#include <mlpack/core.hpp>
+
+#include "genome.hpp"
+
+namespace mlpack {
+namespace neuro_cmaes {
+
+/**
+ * This is enumeration of the precisions of the weights of a frozen genome.
+ */
+enum FrozenPrecision
+{
+    FLOAT32 = 0,
+    INT8,
+};
+
+/**
+ * This class holds the compiled plan of a genome with its current weights
+ * in reduced precision. Every dense layer of the plan, and every other group
+ * of links to one neuron, is a layer of the frozen genome. With INT8 the
+ * weights of a layer are quantized to [-127, 127] with one scale per layer.
+ * Inputs and activations are float; the sums are taken in float and the
+ * activation functions in double.
+ */
+class FrozenGenome {
+ public:
+  // Default constructor.
+  FrozenGenome() : aPrecision(FLOAT32), aNumInput(0), aNumOutput(0) {}
+
+  // Freeze the genome with its current weights, see Genome::BindWeights().
+  FrozenGenome(Genome& genome, FrozenPrecision precision) {
+    Freeze(genome, precision);
+  }
+
+  // Freeze the genome with its current weights, see Genome::BindWeights().
+  void Freeze(Genome& genome, FrozenPrecision precision) {
+    genome.Compile();
+
+    aPrecision = precision;
+    aNumInput = genome.aNumInput;
+    aNumOutput = genome.aNumOutput;
+    aLayers.clear();
+    aSources.clear();
+    aTargets.assign(genome.aPlanTargets.begin(), genome.aPlanTargets.end());
+    aFuncs = genome.aPlanFuncs;
+
+    const double* weights = genome.LinkWeights(genome.aBoundWeights);
+    const ssize_t numGroups = genome.aPlanTargets.size();
+    ssize_t maxSources = 0;
+    for (ssize_t g = 0; g < numGroups; )
+    {
+      // The weights of a layer are row major, one row per target, as in
+      // the plan.
+      FrozenLayer layer;
+      layer.firstTarget = g;
+      layer.firstWeight = genome.aPlanOffsets[g];
+      if (genome.aPlanLayer[g] >= 0)
+      {
+        const Genome::DenseLayer& dense =
+            genome.aLayers[genome.aPlanLayer[g]];
+        layer.numSources = dense.numSources;
+        layer.numTargets = dense.numTargets;
+      }
+      else
+      {
+        layer.numSources = genome.aPlanOffsets[g + 1] - layer.firstWeight;
+        layer.numTargets = 1;
+      }
+      layer.firstSource = aSources.size();
+      aSources.insert(aSources.end(),
+          genome.aPlanSources.begin() + layer.firstWeight,
+          genome.aPlanSources.begin() + layer.firstWeight + layer.numSources);
+
+      const double* w = weights + layer.firstWeight;
+      const ssize_t numWeights = layer.numSources * layer.numTargets;
+      double maxWeight = 0;
+      for (ssize_t i = 0; i < numWeights; ++i)
+        maxWeight = std::max(maxWeight, std::fabs(w[i]));
+      layer.scale = maxWeight > 0 ? maxWeight / 127 : 1;
+
+      maxSources = std::max(maxSources, layer.numSources);
+      aLayers.push_back(layer);
+      g += layer.numTargets;
+    }
+
+    const ssize_t numLink = genome.NumLink();
+    aWeights.clear();
+    aQuantizedWeights.clear();
+    if (precision == FLOAT32)
+    {
+      aWeights.assign(weights, weights + numLink);
+    }
+    else
+    {
+      aQuantizedWeights.resize(numLink);
+      for (size_t l = 0; l < aLayers.size(); ++l)
+      {
+        const FrozenLayer& layer = aLayers[l];
+        const ssize_t end = layer.firstWeight +
+            layer.numSources * layer.numTargets;
+        for (ssize_t i = layer.firstWeight; i < end; ++i)
+        {
+          aQuantizedWeights[i] =
+              (int8_t) std::floor(weights[i] / layer.scale + 0.5);
+        }
+      }
+    }
+
+    aInputs.assign(genome.NumNeuron(), 0.0f);
+    aActivations.resize(genome.NumNeuron());
+    for (ssize_t i = 0; i < genome.NumNeuron(); ++i)
+      aActivations[i] = genome.aNeuronGenes[i].Activation();
+    aLayerIn.resize(maxSources);
+  }
+
+  // Get the precision of the weights.
+  FrozenPrecision Precision() const { return aPrecision; }
+
+  // Get the bytes taken by the weights.
+  size_t WeightBytes() const {
+    return aWeights.size() * sizeof(float) + aQuantizedWeights.size();
+  }
+
+  // Activate the frozen genome, like Genome::Activate().
+  void Activate(const std::vector<double>& input) {
+    assert(input.size() == (size_t) aNumInput);
+
+    std::fill(aInputs.begin(), aInputs.end(), 0.0f);
+    for (ssize_t i=0; i<aNumInput; ++i) {
+      aInputs[i] = input[i];
+      aActivations[i] = input[i];
+    }
+
+    for (size_t l = 0; l < aLayers.size(); ++l)
+    {
+      const FrozenLayer& layer = aLayers[l];
+      const ssize_t* sources = aSources.data() + layer.firstSource;
+      float* in = aLayerIn.data();
+      for (ssize_t c = 0; c < layer.numSources; ++c)
+        in[c] = aActivations[sources[c]];
+
+      for (ssize_t r = 0; r < layer.numTargets; ++r)
+      {
+        const ssize_t offset = layer.firstWeight + r * layer.numSources;
+        const float sum = aPrecision == FLOAT32 ?
+            Dot(aWeights.data() + offset, in, layer.numSources) :
+            Dot(aQuantizedWeights.data() + offset, in, layer.numSources) *
+                layer.scale;
+
+        const ssize_t g = layer.firstTarget + r;
+        const ssize_t toNeuronIdx = aTargets[g];
+        double input = aInputs[toNeuronIdx] + sum;
+        aInputs[toNeuronIdx] = input;
+        NeuronGene::ActivationFunction(aFuncs[g], &input, &input, 1);
+        aActivations[toNeuronIdx] = input;
+      }
+    }
+  }
+
+  // Get the output of the last Activate().
+  void Output(std::vector<double>& output) const {
+    output.assign(aActivations.begin() + aNumInput,
+                  aActivations.begin() + aNumInput + aNumOutput);
+  }
+
+  // Largest absolute difference between the outputs of the frozen genome and
+  // of genome, whose weights it was frozen from, over the columns of inputs.
+  // The inputs are run through copies, so neither genome is changed.
+  double MaxError(const Genome& genome, const arma::mat& inputs) const {
+    Genome reference(genome);
+    FrozenGenome frozen(*this);
+    std::vector<double> input(aNumInput);
+    std::vector<double> output, referenceOutput;
+    double maxError = 0;
+    for (size_t m = 0; m < inputs.n_cols; ++m)
+    {
+      input.assign(inputs.colptr(m), inputs.colptr(m) + aNumInput);
+      frozen.Activate(input);
+      reference.Activate(input);
+      frozen.Output(output);
+      reference.Output(referenceOutput);
+      for (ssize_t i=0; i<aNumOutput; ++i) {
+        maxError = std::max(maxError,
+            std::fabs(output[i] - referenceOutput[i]));
+      }
+    }
+
+    return maxError;
+  }
+
+ private:
+  // Dot product of n weights and in, summed in kLanes interleaved partial
+  // sums so that the loop vectorizes without reassociating float sums.
+  template<typename W>
+  static float Dot(const W* w, const float* in, ssize_t n) {
+    const ssize_t kLanes = 8;
+    float part[kLanes] = { 0 };
+    ssize_t c = 0;
+    for (; c + kLanes <= n; c += kLanes)
+    {
+      for (ssize_t k = 0; k < kLanes; ++k)
+        part[k] += w[c + k] * in[c + k];
+    }
+    for (; c < n; ++c)
+      part[0] += w[c] * in[c];
+
+    float sum = 0;
+    for (ssize_t k = 0; k < kLanes; ++k)
+      sum += part[k];
+    return sum;
+  }
+
+  // The links of numTargets consecutive groups from the same numSources
+  // neurons, aSources[firstSource, firstSource + numSources), with the
+  // weights [firstWeight, firstWeight + numSources * numTargets) and the
+  // scale of the quantized weights.
+  struct FrozenLayer {
+    ssize_t firstTarget;
+    ssize_t numTargets;
+    ssize_t firstSource;
+    ssize_t numSources;
+    ssize_t firstWeight;
+    float scale;
+  };
+
+  // Precision of the weights.
+  FrozenPrecision aPrecision;
+
+  // Input length (include bias).
+  ssize_t aNumInput;
+
+  // Output length.
+  ssize_t aNumOutput;
+
+  // Layers in the order of activation.
+  std::vector<FrozenLayer> aLayers;
+
+  // Source neuron indices of the layers.
+  std::vector<ssize_t> aSources;
+
+  // Neuron index and activation function of the target of every group.
+  std::vector<ssize_t> aTargets;
+  std::vector<ActivationFuncType> aFuncs;
+
+  // Weights in link order, float or quantized.
+  std::vector<float> aWeights;
+  std::vector<int8_t> aQuantizedWeights;
+
+  // Inputs and activations of all neurons.
+  std::vector<float> aInputs;
+  std::vector<float> aActivations;
+
+  // Gathered sources of a layer during Activate().
+  std::vector<float> aLayerIn;
+};
+
+}  // namespace neuro_cmaes
+}  // namespace mlpack
+
+#endif  // MLPACK_METHODS_NEURO_CMAES_FROZEN_GENOME_HPP
@@ -0,0 +1,103 @@
+/**
+ * @file frozen_genome_test.cpp
+ * @author www.github.com/Kartik-Nighania
+ *
+ * Checks the accuracy of FrozenGenome on the 170-6-5 network of the Super
+ * Mario Bros driver, with weights drawn around the start point of the
+ * driver and random tile-code frames as inputs: the outputs of the FLOAT32
+ * and INT8 genomes must stay within a fixed bound of the double genome.
+ *
+ * Usage: frozen_genome_test
+ *
+ * Exits with 1 and names the failing case if an error exceeds its bound.
+ */
+
+#include <mlpack/core.hpp>
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "frozen_genome.hpp"
+#include "genome.hpp"
+
+using namespace mlpack::neuro_cmaes;
+
+namespace {
+
+//! The network of the driver: 169 inputs and a bias, 6 sigmoid hidden
+//! neurons fully connected to the inputs and 5 sigmoid outputs fully
+//! connected to the hidden neurons.
+Genome Network()
+{
+  std::vector<NeuronGene> neuronGenes;
+  std::vector<LinkGene> linkGenes;
+  for (size_t i = 0; i < 169; ++i)
+    neuronGenes.push_back(NeuronGene(i, INPUT, LINEAR, 0, 0, 0));
+  neuronGenes.push_back(NeuronGene(169, BIAS, LINEAR, 0, 0, 0));
+  for (size_t i = 170; i < 175; ++i)
+    neuronGenes.push_back(NeuronGene(i, OUTPUT, SIGMOID, 1, 0, 0));
+  for (size_t i = 175; i < 181; ++i)
+    neuronGenes.push_back(NeuronGene(i, HIDDEN, SIGMOID, 0.5, 0, 0));
+
+  for (size_t j = 175; j < 181; ++j)
+    for (size_t i = 0; i < 170; ++i)
+      linkGenes.push_back(LinkGene(i, j, 0));
+  for (size_t j = 175; j < 181; ++j)
+    for (size_t i = 170; i < 175; ++i)
+      linkGenes.push_back(LinkGene(j, i, 0));
+
+  Genome genome(neuronGenes, linkGenes, 170, 5);
+  genome.SortLinkGenes();
+  return genome;
+}
+
+}  // namespace
+
+int main()
+{
+  // Largest absolute output error of each precision. The float32 sums lose
+  // about 1e-7 relative to double; int8 rounds every weight by up to 1/254
+  // of the largest weight of its layer.
+  const FrozenPrecision precisions[] = { FLOAT32, INT8 };
+  const char* names[] = { "FLOAT32", "INT8" };
+  const double bounds[] = { 1e-6, 1e-2 };
+
+  std::mt19937 random(1);
+  std::normal_distribution<double> normal;
+
+  bool passed = true;
+  for (int trial = 0; trial < 5; ++trial)
+  {
+    Genome genome = Network();
+    std::vector<double> weights(genome.NumParam());
+    for (size_t i = 0; i < weights.size(); ++i)
+      weights[i] = 0.5 + 0.3 * normal(random);
+    genome.BindWeights(weights.data());
+
+    // Tile codes of 500 random frames, followed by the bias input.
+    arma::mat inputs(170, 500);
+    for (size_t m = 0; m < inputs.n_cols; ++m)
+    {
+      for (size_t i = 0; i < 169; ++i)
+        inputs(i, m) = random() % 4;
+      inputs(169, m) = 1;
+    }
+
+    for (size_t p = 0; p < sizeof(precisions) / sizeof(precisions[0]); ++p)
+    {
+      const FrozenGenome frozen(genome, precisions[p]);
+      const double error = frozen.MaxError(genome, inputs);
+      std::printf("trial %d, %s: max error %g, bound %g\n", trial, names[p],
+          error, bounds[p]);
+      passed = passed && error <= bounds[p];
+    }
+  }
+
+  if (!passed)
+  {
+    std::printf("FAILED: a frozen genome exceeded its error bound\n");
+    return 1;
+  }
+  return 0;
+}
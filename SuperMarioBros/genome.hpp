@@ -2,8 +2,11 @@
 #define MLPACK_METHODS_NEURO_CMAES_GENOME_HPP
 
 #include <cstddef>
+#include <algorithm>
 #include <cassert>
 #include <map>
+#include <unordered_map>
+#include <vector>
 
 #include <mlpack/core.hpp>
 
@@ -14,6 +17,9 @@
 namespace mlpack {
 namespace neuro_cmaes {
 
+class FrozenGenome;
+class MappedGenome;
+
 /**
  * This class defines a genome.
  # A genome which uses neurons and links class to make its structure.
@@ -31,6 +37,10 @@ class Genome {
    {
     aNumInput = 0;
     aNumOutput = 0;
+    aBoundWeights = NULL;
+    aIndexedNeurons = -1;
+    aNumLevels = 0;
+    aCompiled = false;
    }
   
   // Parametric constructor.
@@ -42,8 +52,14 @@ class Genome {
     aNeuronGenes(neuronGenes),
     aLinkGenes(linkGenes),
     aNumInput(numInput),
-    aNumOutput(numOutput)
-  {}
+    aNumOutput(numOutput),
+    aIndexedNeurons(-1),
+    aNumLevels(0),
+    aBoundWeights(NULL),
+    aCompiled(false)
+  {
+    SyncLinkParams();
+  }
 
   // Copy constructor.
   Genome(const Genome& genome) 
@@ -52,6 +68,12 @@ class Genome {
     aLinkGenes = genome.aLinkGenes;
     aNumInput = genome.aNumInput;
     aNumOutput = genome.aNumOutput;
+    aLinkParams = genome.aLinkParams;
+    aBoundWeights = genome.aBoundWeights;
+    aIndexedNeurons = -1;
+    aNeuronLevels = genome.aNeuronLevels;
+    aNumLevels = genome.aNumLevels;
+    aCompiled = false;
   }
 
   // Destructor.
@@ -65,6 +87,12 @@ class Genome {
       aLinkGenes = genome.aLinkGenes;
       aNumInput = genome.aNumInput;
       aNumOutput = genome.aNumOutput;
+      aLinkParams = genome.aLinkParams;
+      aBoundWeights = genome.aBoundWeights;
+      aIndexedNeurons = -1;
+      aNeuronLevels = genome.aNeuronLevels;
+      aNumLevels = genome.aNumLevels;
+      aCompiled = false;
     }
 
     return *this;
@@ -74,7 +102,10 @@ class Genome {
   ssize_t NumInput() { return aNumInput; }
 
   // Set input length.
-  void NumInput(ssize_t numInput) { aNumInput = numInput; }
+  void NumInput(ssize_t numInput) {
+    aNumInput = numInput;
+    aCompiled = false;
+  }
 
   // Get output length.
   ssize_t NumOutput() { return aNumOutput; }
@@ -114,36 +145,33 @@ class Genome {
 
   // Whether specified neuron id exist in this genome.
   bool HasNeuronId(ssize_t id) const {
-    for (ssize_t i=0; i<NumNeuron(); ++i) {
-      if (aNeuronGenes[i].Id() == id) {
-        return true;
-      }
-    }
-    
-    return false;
+    return GetNeuronIndex(id) >= 0;
   }
 
   // Get neuron by id.
   void GetNeuronById(ssize_t id, NeuronGene& neuronGene) {
-    assert(HasNeuronId(id));
+    ssize_t index = GetNeuronIndex(id);
+    assert(index >= 0);
 
-    for (ssize_t i=0; i<NumNeuron(); ++i) {
-      if (aNeuronGenes[i].Id() == id) {
-        neuronGene = aNeuronGenes[i];
-        return;
-      }
-    }
+    neuronGene = aNeuronGenes[index];
   }
 
-  // Get neuron index by id.
+  // Get neuron index by id, -1 if there is none. Looks the id up in a table
+  // that is rebuilt when the number of neurons changes, and once more on a
+  // miss or when the table points to a neuron with another id, so ids
+  // changed in place through aNeuronGenes are found without Invalidate().
   ssize_t GetNeuronIndex(ssize_t id) const {
-    for(ssize_t i=0; i < NumNeuron(); ++i) {
-        if (aNeuronGenes[i].Id() == id) {
-            return i;
-        }
+    bool fresh = aIndexedNeurons != NumNeuron();
+    if (fresh)
+      IndexNeurons();
+
+    ssize_t index = LookUpNeuron(id);
+    if (!fresh && (index < 0 || aNeuronGenes[index].Id() != id)) {
+      IndexNeurons();
+      index = LookUpNeuron(id);
     }
 
-    return -1;  // Id start from 0.
+    return index;  // Id start from 0.
   }
 
    void Flush() 
@@ -155,76 +183,423 @@ class Genome {
      }
    }
 
-   // Sort link genes by toNeuron's depth.
+  // Sort link genes into topological order, computed from the links in
+  // O(neurons + links). The links are grouped by their target neuron and
+  // the groups are ordered by the level of the target: neurons without
+  // incoming links have level 0, the others one more than their highest
+  // source. Neurons of one level do not depend on each other; within a level
+  // they are in the order of aNeuronGenes. If the links have cycles, the
+  // unsorted neuron of least depth is taken next, and its links from
+  // unsorted neurons read the activations of the previous Activate().
+  // Links to the same neuron keep their order, and every link keeps its
+  // parameter; see RenumberLinkParams() to read bound weights in place.
   void SortLinkGenes() {
-    struct DepthAndLink
-    {
-      double depth;
-      LinkGene link;
- 
-      DepthAndLink(double d, LinkGene& l) : depth(d), link(l) {}
+    SyncLinkParams();
+    const ssize_t numNeuron = NumNeuron();
+    const ssize_t numLink = NumLink();
+
+    // Outgoing links of every neuron in CSR form; self links do not order
+    // anything.
+    std::vector<ssize_t> toNeuronIdx(numLink);
+    std::vector<ssize_t> inDegree(numNeuron, 0);
+    std::vector<ssize_t> outOffsets(numNeuron + 1, 0);
+    for (ssize_t i=0; i<numLink; ++i) {
+      ssize_t fromNeuronIdx = GetNeuronIndex(aLinkGenes[i].FromNeuronId());
+      toNeuronIdx[i] = GetNeuronIndex(aLinkGenes[i].ToNeuronId());
+      assert(fromNeuronIdx >= 0 && toNeuronIdx[i] >= 0);
+      if (fromNeuronIdx != toNeuronIdx[i]) {
+        ++inDegree[toNeuronIdx[i]];
+        ++outOffsets[fromNeuronIdx + 1];
+      }
+    }
+    for (ssize_t v=0; v<numNeuron; ++v)
+      outOffsets[v + 1] += outOffsets[v];
+    std::vector<ssize_t> outNeurons(outOffsets[numNeuron]);
+    std::vector<ssize_t> outFill(outOffsets.begin(), outOffsets.end() - 1);
+    for (ssize_t i=0; i<numLink; ++i) {
+      ssize_t fromNeuronIdx = GetNeuronIndex(aLinkGenes[i].FromNeuronId());
+      if (fromNeuronIdx != toNeuronIdx[i])
+        outNeurons[outFill[fromNeuronIdx]++] = toNeuronIdx[i];
+    }
 
-      bool operator < (const DepthAndLink& dL) const
-      {
-        return (depth < dL.depth);
+    // Kahn's algorithm, with the queue kept in order.
+    std::vector<ssize_t> order;
+    std::vector<char> queued(numNeuron, 0);
+    std::vector<ssize_t> byDepth;
+    size_t nextByDepth = 0;
+    order.reserve(numNeuron);
+    aNeuronLevels.assign(numNeuron, 0);
+    for (ssize_t v=0; v<numNeuron; ++v) {
+      if (inDegree[v] == 0) {
+        queued[v] = 1;
+        order.push_back(v);
+      }
+    }
+    for (size_t head = 0; head < (size_t) numNeuron; ++head) {
+      if (head == order.size()) {
+        // Break a cycle.
+        if (byDepth.empty()) {
+          for (ssize_t v=0; v<numNeuron; ++v)
+            byDepth.push_back(v);
+          std::stable_sort(byDepth.begin(), byDepth.end(), DepthLess(*this));
+        }
+        while (queued[byDepth[nextByDepth]])
+          ++nextByDepth;
+        queued[byDepth[nextByDepth]] = 1;
+        order.push_back(byDepth[nextByDepth]);
       }
-    };
 
-    std::vector<double> toNeuronDepths;
-    for (ssize_t i=0; i<aLinkGenes.size(); ++i) {
-      NeuronGene toNeuron;
-      GetNeuronById(aLinkGenes[i].ToNeuronId(), toNeuron);
-      toNeuronDepths.push_back(toNeuron.Depth());
+      const ssize_t v = order[head];
+      for (ssize_t k = outOffsets[v]; k < outOffsets[v + 1]; ++k) {
+        const ssize_t w = outNeurons[k];
+        if (queued[w])
+          continue;
+        aNeuronLevels[w] = std::max(aNeuronLevels[w], aNeuronLevels[v] + 1);
+        if (--inDegree[w] == 0) {
+          queued[w] = 1;
+          order.push_back(w);
+        }
+      }
     }
 
-    std::vector<DepthAndLink> depthAndLinks;
-    ssize_t linkGenesSize = aLinkGenes.size();
-    for (ssize_t i=0; i<linkGenesSize; ++i) {
-      depthAndLinks.push_back(DepthAndLink(toNeuronDepths[i], aLinkGenes[i]));
+    // Rank the neurons by level, then stably sort the links by the rank of
+    // their target.
+    aNumLevels = 0;
+    for (ssize_t v=0; v<numNeuron; ++v)
+      aNumLevels = std::max(aNumLevels, aNeuronLevels[v] + 1);
+    std::vector<ssize_t> levelOffsets(aNumLevels + 1, 0);
+    for (ssize_t v=0; v<numNeuron; ++v)
+      ++levelOffsets[aNeuronLevels[v] + 1];
+    for (ssize_t l=0; l<aNumLevels; ++l)
+      levelOffsets[l + 1] += levelOffsets[l];
+    std::vector<ssize_t> rank(numNeuron);
+    for (ssize_t v=0; v<numNeuron; ++v)
+      rank[v] = levelOffsets[aNeuronLevels[v]]++;
+
+    std::vector<ssize_t> linkOffsets(numNeuron + 1, 0);
+    for (ssize_t i=0; i<numLink; ++i)
+      ++linkOffsets[rank[toNeuronIdx[i]] + 1];
+    for (ssize_t v=0; v<numNeuron; ++v)
+      linkOffsets[v + 1] += linkOffsets[v];
+    std::vector<LinkGene> linkGenes(numLink);
+    std::vector<ssize_t> linkParams(numLink);
+    for (ssize_t i=0; i<numLink; ++i) {
+      ssize_t j = linkOffsets[rank[toNeuronIdx[i]]]++;
+      linkGenes[j] = aLinkGenes[i];
+      linkParams[j] = aLinkParams[i];
     }
+    aLinkGenes.swap(linkGenes);
+    aLinkParams.swap(linkParams);
+    aCompiled = false;
+  }
 
-    std::sort(depthAndLinks.begin(), depthAndLinks.end());
+  // Get the number of levels found by the last SortLinkGenes().
+  ssize_t NumLevel() const { return aNumLevels; }
 
-    for (ssize_t i=0; i<linkGenesSize; ++i) {
-      aLinkGenes[i] = depthAndLinks[i].link;
+  // Get the level of a neuron, by index, found by the last SortLinkGenes().
+  ssize_t NeuronLevel(ssize_t index) const { return aNeuronLevels[index]; }
+
+  // Get the index of the weight of a link in a parameter vector. Initially
+  // link i of the constructor gets parameter i, and links appended to
+  // aLinkGenes later get the next unused parameters.
+  ssize_t LinkParam(ssize_t link) {
+    SyncLinkParams();
+    return aLinkParams[link];
+  }
+
+  // Set the parameter of a link. Links may share a parameter.
+  void LinkParam(ssize_t link, ssize_t param) {
+    SyncLinkParams();
+    aLinkParams[link] = param;
+    aCompiled = false;
+  }
+
+  // Get the length of the parameter vectors.
+  ssize_t NumParam() {
+    SyncLinkParams();
+    return aLinkParams.empty() ? 0 :
+        *std::max_element(aLinkParams.begin(), aLinkParams.end()) + 1;
+  }
+
+  // Number the parameters in link order, e.g. after SortLinkGenes(), so that
+  // Activate() reads bound weights in place. Links sharing a parameter keep
+  // sharing one, and unused parameters are dropped. oldParams[k] receives
+  // the previous number of parameter k, to reorder parameter vectors.
+  void RenumberLinkParams(std::vector<ssize_t>& oldParams) {
+    SyncLinkParams();
+    std::vector<ssize_t> newParams(NumParam(), -1);
+    oldParams.clear();
+    for (ssize_t i=0; i<NumLink(); ++i) {
+      ssize_t& param = newParams[aLinkParams[i]];
+      if (param < 0) {
+        param = oldParams.size();
+        oldParams.push_back(aLinkParams[i]);
+      }
+      aLinkParams[i] = param;
     }
+    aCompiled = false;
   }
 
+  // Whether bound weights are read in place, which needs the parameters of
+  // the links to be consecutive in link order. Otherwise Activate() gathers
+  // them first.
+  bool WeightsInPlace() {
+    if (!aCompiled)
+      Compile();
+
+    return aParamOffset >= 0;
+  }
+
+  // Read the weight of every link from weights[LinkParam(link)] instead of
+  // aLinkGenes, or from aLinkGenes again if weights is NULL. The weights are
+  // not copied; they must stay valid while bound. The weights of aLinkGenes
+  // are not changed.
+  void BindWeights(const double* weights) { aBoundWeights = weights; }
+
+  // Get the bound weights, NULL if the weights of aLinkGenes are used.
+  const double* BoundWeights() const { return aBoundWeights; }
+
+  // Marks the plan of Activate() and the neuron id table as outdated. Needed
+  // after the neurons or links were changed through aNeuronGenes or
+  // aLinkGenes, except for changes of the weights, activations and inputs.
+  void Invalidate() {
+    aCompiled = false;
+    aIndexedNeurons = -1;
+  }
+
+  // Compile the links into the plan run by Activate(): the neuron indices
+  // are resolved once and the links are stored in CSR form, one group for
+  // every run of consecutive links to the same neuron, which is activated
+  // after its group.
+  void Compile() {
+    aPlanTargets.clear();
+    aPlanFuncs.clear();
+    aPlanOffsets.clear();
+    aPlanSources.clear();
+    aPlanSources.reserve(NumLink());
+    aPlanWeights.resize(NumLink());
+
+    for (ssize_t i=0; i<NumLink(); ++i) {
+      ssize_t toNeuronIdx = GetNeuronIndex(aLinkGenes[i].ToNeuronId());
+      ssize_t fromNeuronIdx = GetNeuronIndex(aLinkGenes[i].FromNeuronId());
+      assert(toNeuronIdx >= 0 && fromNeuronIdx >= 0);
+
+      if (aPlanTargets.empty() || aPlanTargets.back() != toNeuronIdx) {
+        aPlanTargets.push_back(toNeuronIdx);
+        aPlanFuncs.push_back(aNeuronGenes[toNeuronIdx].ActFuncType());
+        aPlanOffsets.push_back(i);
+      }
+      aPlanSources.push_back(fromNeuronIdx);
+    }
+    aPlanOffsets.push_back(NumLink());
+
+    // If the parameters of the links are consecutive, the bound weights are
+    // used in place.
+    SyncLinkParams();
+    aParamOffset = NumLink() > 0 ? aLinkParams[0] : 0;
+    for (ssize_t i=1; i<NumLink(); ++i) {
+      if (aLinkParams[i] != aParamOffset + i)
+        aParamOffset = -1;
+    }
+
+    FindDenseLayers();
+
+    aInputs.resize(NumNeuron());
+    aActivations.resize(NumNeuron());
+    aInputNonzeros.resize(std::max<ssize_t>(aNumInput, 0));
+    aCompiled = true;
+  }
+
+
+  // Find the fully connected layers of the plan: runs of at least two
+  // consecutive groups with the same sources in the same order, none of
+  // which is a target of the run. Activate() evaluates such a run as one
+  // matrix-vector product; the other groups are summed link by link.
+  void FindDenseLayers() {
+    const ssize_t numGroups = aPlanTargets.size();
+    aLayers.clear();
+    aPlanLayer.assign(numGroups, -1);
+
+    ssize_t maxSources = 0;
+    ssize_t maxTargets = 0;
+    std::vector<char> isTarget(NumNeuron(), 0);
+
+    // Layers of input neurons may skip the zero inputs, unless an input
+    // neuron is the target of a link.
+    bool inputIsTarget = false;
+    for (ssize_t g = 0; g < numGroups; ++g)
+      inputIsTarget = inputIsTarget || aPlanTargets[g] < aNumInput;
+    for (ssize_t g = 0; g < numGroups; )
+    {
+      const ssize_t first = aPlanOffsets[g];
+      const ssize_t numSources = aPlanOffsets[g + 1] - first;
+
+      // Grow the run while the next group has the same sources, and stop
+      // before a target is repeated or read by the run.
+      ssize_t end = g;
+      while (end < numGroups &&
+             aPlanOffsets[end + 1] - aPlanOffsets[end] == numSources &&
+             !isTarget[aPlanTargets[end]] &&
+             std::equal(aPlanSources.begin() + first,
+                        aPlanSources.begin() + first + numSources,
+                        aPlanSources.begin() + aPlanOffsets[end]))
+      {
+        isTarget[aPlanTargets[end]] = 1;
+        ++end;
+      }
+      for (ssize_t c = 0; c < numSources; ++c)
+      {
+        while (end > g && isTarget[aPlanSources[first + c]])
+          isTarget[aPlanTargets[--end]] = 0;
+      }
+      for (ssize_t r = g; r < end; ++r)
+        isTarget[aPlanTargets[r]] = 0;
+
+      if (end - g < 2)
+      {
+        ++g;
+        continue;
+      }
+
+      DenseLayer layer;
+      layer.firstLink = first;
+      layer.numSources = numSources;
+      layer.numTargets = end - g;
+      layer.firstSource = aPlanSources[first];
+      for (ssize_t c = 1; c < numSources; ++c)
+      {
+        if (aPlanSources[first + c] != layer.firstSource + c)
+          layer.firstSource = -1;
+      }
+      layer.readsInputs = !inputIsTarget && layer.firstSource >= 0 &&
+          layer.firstSource + numSources <= aNumInput;
+      maxSources = std::max(maxSources, layer.numSources);
+      maxTargets = std::max(maxTargets, layer.numTargets);
+
+      aPlanLayer[g] = aLayers.size();
+      aLayers.push_back(layer);
+      g = end;
+    }
+
+    aLayerIn.set_size(maxSources);
+    aLayerOut.set_size(maxTargets);
+  }
+
+  // Number of fully connected layers found by Compile().
+  ssize_t NumDenseLayer() {
+    if (!aCompiled)
+      Compile();
+
+    return aLayers.size();
+  }
 
   // Activate genome. The last dimension of input is always 1 for bias. 0 means no bias.
   void Activate(std::vector<double>& input) {
     assert(input.size() == aNumInput);
-    
-    // Set all neurons' input to be 0.
+
+    if (!aCompiled || aInputs.size() != aNeuronGenes.size() ||
+        aPlanWeights.size() != aLinkGenes.size())
+      Compile();
+
+    // Set all neurons' input to be 0, and the input neurons.
+    // assume INPUT, BIAS, OUTPUT, HIDDEN sequence
+    std::fill(aInputs.begin(), aInputs.end(), 0.0);
     for (ssize_t i=0; i<NumNeuron(); ++i) {
-      aNeuronGenes[i].Input(0);
+      aActivations[i] = aNeuronGenes[i].Activation();
     }
-    
-    // Set input neurons.
+    // Collect the nonzero inputs for the layers that read only input
+    // neurons, without branches.
+    size_t numNonzeros = 0;
+    ssize_t* nonzeros = aInputNonzeros.data();
     for (ssize_t i=0; i<aNumInput; ++i) {
-      aNeuronGenes[i].Input(input[i]);  // assume INPUT, BIAS, OUTPUT, HIDDEN sequence
-      aNeuronGenes[i].Activation(input[i]);
+      aInputs[i] = input[i];
+      aActivations[i] = input[i];
+      nonzeros[numNonzeros] = i;
+      numNonzeros += input[i] != 0;
     }
 
     // Activate hidden and output neurons.
-    for (ssize_t i = 0; i < NumLink(); ++i) 
+    const ssize_t* sources = aPlanSources.data();
+    const double* weights = LinkWeights(aBoundWeights);
+    double* activations = aActivations.data();
+    for (size_t g = 0; g < aPlanTargets.size(); ++g)
     {
-     
-        ssize_t toNeuronIdx = GetNeuronIndex(aLinkGenes[i].ToNeuronId());
-        ssize_t fromNeuronIdx = GetNeuronIndex(aLinkGenes[i].FromNeuronId());
-        double input = aNeuronGenes[toNeuronIdx].Input() + 
-                       aNeuronGenes[fromNeuronIdx].Activation() * aLinkGenes[i].Weight();
-        aNeuronGenes[toNeuronIdx].Input(input);
-        
-        if (i == NumLink() - 1) 
+      if (aPlanLayer[g] >= 0)
+      {
+        // Row r of the layer holds the weights of group g + r, which are
+        // stored consecutively, so the links form a column major matrix
+        // with one column per target.
+        const DenseLayer& layer = aLayers[aPlanLayer[g]];
+        double* layerIn = aLayerIn.memptr();
+        if (layer.firstSource >= 0)
+          layerIn = activations + layer.firstSource;
+        else
+        {
+          const ssize_t* layerSources = sources + layer.firstLink;
+          for (ssize_t c = 0; c < layer.numSources; ++c)
+            layerIn[c] = activations[layerSources[c]];
+        }
+
+        const arma::mat w(const_cast<double*>(weights) + layer.firstLink,
+            layer.numSources, layer.numTargets, false, true);
+        const arma::vec x(layerIn, layer.numSources, false, true);
+        arma::vec y(aLayerOut.memptr(), layer.numTargets, false, true);
+        if (layer.readsInputs && 2 * numNonzeros < (size_t) layer.numSources)
         {
-          aNeuronGenes[toNeuronIdx].CalcActivation();
+          // Most inputs are zero: add up the rows of w of the others only.
+          y.zeros();
+          for (size_t k = 0; k < numNonzeros; ++k)
+          {
+            const ssize_t c = nonzeros[k] - layer.firstSource;
+            if (c < 0 || c >= layer.numSources)
+              continue;
+
+            const double* row = weights + layer.firstLink + c;
+            const double value = layerIn[c];
+            for (ssize_t r = 0; r < layer.numTargets; ++r)
+              y[r] += row[r * layer.numSources] * value;
+          }
         }
-         else if (GetNeuronIndex(aLinkGenes[i + 1].ToNeuronId()) != toNeuronIdx) 
+        else
         {
-          aNeuronGenes[toNeuronIdx].CalcActivation();
+          y = w.t() * x;
         }
-      
+
+        for (ssize_t r = 0; r < layer.numTargets; ++r)
+        {
+          y[r] += aInputs[aPlanTargets[g + r]];
+          aInputs[aPlanTargets[g + r]] = y[r];
+        }
+
+        // Apply the activation functions to runs of targets sharing one.
+        for (ssize_t r = 0, end; r < layer.numTargets; r = end)
+        {
+          end = r + 1;
+          while (end < layer.numTargets &&
+                 aPlanFuncs[g + end] == aPlanFuncs[g + r])
+            ++end;
+          NeuronGene::ActivationFunction(aPlanFuncs[g + r], y.memptr() + r,
+              y.memptr() + r, end - r);
+        }
+
+        for (ssize_t r = 0; r < layer.numTargets; ++r, ++g)
+          activations[aPlanTargets[g]] = y[r];
+        --g;
+        continue;
+      }
+
+      ssize_t toNeuronIdx = aPlanTargets[g];
+      double sum = aInputs[toNeuronIdx];
+      for (ssize_t i = aPlanOffsets[g]; i < aPlanOffsets[g + 1]; ++i)
+        sum += activations[sources[i]] * weights[i];
+      aInputs[toNeuronIdx] = sum;
+      NeuronGene::ActivationFunction(aPlanFuncs[g], &sum,
+          activations + toNeuronIdx, 1);
+    }
+
+    for (ssize_t i=0; i<NumNeuron(); ++i) {
+      aNeuronGenes[i].Input(aInputs[i]);
+      aNeuronGenes[i].Activation(aActivations[i]);
     }
   }
 
@@ -236,14 +611,288 @@ class Genome {
     }
   }
 
+  // Activate the genome for a batch of weight vectors, e.g. the population
+  // of CMAES::populationMatrix(), and a batch of inputs. Column j of weights
+  // is the parameter vector of candidate j, see LinkParam(), and column
+  // m of inputs is one input of Activate(). Column m of slice j of outputs
+  // receives the output of candidate j for input m. Every candidate starts
+  // from the current activations of the neurons, which are not changed.
+  // A fully connected layer of input neurons has the same sources for every
+  // candidate and is one matrix product for the whole population, with the
+  // weights of all candidates side by side. The other fully connected layers
+  // are one matrix product per candidate, whose sources differ.
+  void ActivateBatch(const arma::mat& weights, const arma::mat& inputs,
+                     arma::cube& outputs) {
+    assert(weights.n_rows >= (size_t) NumParam());
+    assert(inputs.n_rows == (size_t) aNumInput);
+
+    if (!aCompiled || aInputs.size() != aNeuronGenes.size() ||
+        aPlanWeights.size() != aLinkGenes.size())
+      Compile();
+
+    // Inputs and activations of neuron i for all inputs are column i.
+    const size_t numSamples = inputs.n_cols;
+    arma::mat initialSums(numSamples, NumNeuron());
+    arma::mat initialActivations(numSamples, NumNeuron());
+    for (ssize_t i=0; i<NumNeuron(); ++i) {
+      double* sum = initialSums.colptr(i);
+      double* act = initialActivations.colptr(i);
+      for (size_t m = 0; m < numSamples; ++m) {
+        sum[m] = i < aNumInput ? inputs(i, m) : 0.0;
+        act[m] = i < aNumInput ? inputs(i, m) : aNeuronGenes[i].Activation();
+      }
+    }
+
+    // Column j * numTargets + r of the product of a layer of input neurons
+    // belongs to target r of candidate j.
+    std::vector<arma::mat> inputLayerOut(aLayers.size());
+    arma::mat layerWeights;
+    for (size_t l = 0; l < aLayers.size(); ++l)
+    {
+      const DenseLayer& layer = aLayers[l];
+      if (!layer.readsInputs)
+        continue;
+
+      const ssize_t numLayerWeights = layer.numSources * layer.numTargets;
+      layerWeights.set_size(layer.numSources,
+          layer.numTargets * weights.n_cols);
+      for (size_t j = 0; j < weights.n_cols; ++j)
+      {
+        const double* w = LinkWeights(weights.colptr(j)) + layer.firstLink;
+        std::copy(w, w + numLayerWeights,
+            layerWeights.colptr(j * layer.numTargets));
+      }
+
+      const arma::mat x(initialActivations.colptr(layer.firstSource),
+          numSamples, layer.numSources, false, true);
+      inputLayerOut[l] = x * layerWeights;
+    }
+
+    arma::mat sums;
+    arma::mat activations;
+    arma::mat layerIn;
+    arma::mat layerOut;
+    outputs.set_size(aNumOutput, numSamples, weights.n_cols);
+    for (size_t j = 0; j < weights.n_cols; ++j)
+    {
+      double* w = const_cast<double*>(LinkWeights(weights.colptr(j)));
+      sums = initialSums;
+      activations = initialActivations;
+
+      for (size_t g = 0; g < aPlanTargets.size(); ++g)
+      {
+        if (aPlanLayer[g] >= 0)
+        {
+          const DenseLayer& layer = aLayers[aPlanLayer[g]];
+          const double* products;
+          if (layer.readsInputs)
+          {
+            products = inputLayerOut[aPlanLayer[g]].colptr(
+                j * layer.numTargets);
+          }
+          else
+          {
+            if (layer.firstSource < 0)
+            {
+              layerIn.set_size(numSamples, layer.numSources);
+              for (ssize_t c = 0; c < layer.numSources; ++c)
+              {
+                const double* source =
+                    activations.colptr(aPlanSources[layer.firstLink + c]);
+                std::copy(source, source + numSamples, layerIn.colptr(c));
+              }
+            }
+
+            const arma::mat x(layer.firstSource < 0 ? layerIn.memptr() :
+                activations.colptr(layer.firstSource), numSamples,
+                layer.numSources, false, true);
+            const arma::mat candidateWeights(w + layer.firstLink,
+                layer.numSources, layer.numTargets, false, true);
+            layerOut = x * candidateWeights;
+            products = layerOut.memptr();
+          }
+
+          for (ssize_t r = 0; r < layer.numTargets; ++r, ++g)
+          {
+            double* sum = sums.colptr(aPlanTargets[g]);
+            double* act = activations.colptr(aPlanTargets[g]);
+            const double* product = products + r * numSamples;
+            for (size_t m = 0; m < numSamples; ++m)
+              sum[m] += product[m];
+            NeuronGene::ActivationFunction(aPlanFuncs[g], sum, act,
+                numSamples);
+          }
+          --g;
+          continue;
+        }
+
+        double* sum = sums.colptr(aPlanTargets[g]);
+        double* act = activations.colptr(aPlanTargets[g]);
+        for (ssize_t i = aPlanOffsets[g]; i < aPlanOffsets[g + 1]; ++i)
+        {
+          const double* source = activations.colptr(aPlanSources[i]);
+          for (size_t m = 0; m < numSamples; ++m)
+            sum[m] += source[m] * w[i];
+        }
+        NeuronGene::ActivationFunction(aPlanFuncs[g], sum, act, numSamples);
+      }
+
+      arma::mat& output = outputs.slice(j);
+      for (ssize_t i=0; i<aNumOutput; ++i) {
+        const double* act = activations.colptr(aNumInput + i);
+        for (size_t m = 0; m < numSamples; ++m)
+          output(i, m) = act[m];
+      }
+    }
+  }
+
 
  private:
+  // Read the plan and the weights.
+  friend class FrozenGenome;
+  friend class MappedGenome;
+
+  // Build the neuron id table: a vector indexed by id if the ids are small
+  // enough, a hash map otherwise. The first neuron with an id wins.
+  void IndexNeurons() const {
+    ssize_t maxId = -1;
+    bool dense = true;
+    for (ssize_t i=0; i<NumNeuron(); ++i) {
+      dense = dense && aNeuronGenes[i].Id() >= 0;
+      maxId = std::max(maxId, aNeuronGenes[i].Id());
+    }
+    aDenseNeuronIndex = dense && maxId < 2 * NumNeuron() + 64;
+
+    aNeuronIndex.clear();
+    aNeuronIndexMap.clear();
+    if (aDenseNeuronIndex)
+      aNeuronIndex.assign(maxId + 1, -1);
+    for (ssize_t i=NumNeuron() - 1; i>=0; --i) {
+      if (aDenseNeuronIndex)
+        aNeuronIndex[aNeuronGenes[i].Id()] = i;
+      else
+        aNeuronIndexMap[aNeuronGenes[i].Id()] = i;
+    }
+    aIndexedNeurons = NumNeuron();
+  }
+
+  // Index of the neuron id in the table, -1 if it is not in it.
+  ssize_t LookUpNeuron(ssize_t id) const {
+    if (aDenseNeuronIndex)
+      return id >= 0 && id < (ssize_t) aNeuronIndex.size() ?
+          aNeuronIndex[id] : -1;
+
+    std::unordered_map<ssize_t, ssize_t>::const_iterator it =
+        aNeuronIndexMap.find(id);
+    return it == aNeuronIndexMap.end() ? -1 : it->second;
+  }
+
+  // Orders neuron indices by the depth of the neurons.
+  struct DepthLess {
+    const Genome& genome;
+
+    explicit DepthLess(const Genome& genome) : genome(genome) {}
+
+    bool operator()(ssize_t a, ssize_t b) const {
+      return genome.aNeuronGenes[a].Depth() < genome.aNeuronGenes[b].Depth();
+    }
+  };
+
+  // Give the links appended to aLinkGenes the next unused parameters.
+  void SyncLinkParams() {
+    if (aLinkParams.size() == aLinkGenes.size())
+      return;
+
+    ssize_t next = aLinkParams.empty() ? 0 :
+        *std::max_element(aLinkParams.begin(), aLinkParams.end()) + 1;
+    while (aLinkParams.size() < aLinkGenes.size())
+      aLinkParams.push_back(next++);
+    aLinkParams.resize(aLinkGenes.size());
+  }
+
+  // Weights of the links in link order taken from the parameter vector
+  // params, or from aLinkGenes if params is NULL. Consecutive parameters are
+  // used in place, otherwise the weights are gathered into aPlanWeights.
+  const double* LinkWeights(const double* params) {
+    if (params != NULL && aParamOffset >= 0)
+      return params + aParamOffset;
+
+    for (ssize_t i=0; i<NumLink(); ++i) {
+      aPlanWeights[i] = params != NULL ? params[aLinkParams[i]] :
+                                         aLinkGenes[i].Weight();
+    }
+    return aPlanWeights.data();
+  }
+
   // Input length (include bias). 
   ssize_t aNumInput;
 
   // Output length.
   ssize_t aNumOutput;
 
+  // Neuron index by id, see IndexNeurons(), and the number of neurons when
+  // it was built, -1 if it is outdated.
+  mutable std::vector<ssize_t> aNeuronIndex;
+  mutable std::unordered_map<ssize_t, ssize_t> aNeuronIndexMap;
+  mutable bool aDenseNeuronIndex;
+  mutable ssize_t aIndexedNeurons;
+
+  // Level of every neuron and number of levels, see SortLinkGenes().
+  std::vector<ssize_t> aNeuronLevels;
+  ssize_t aNumLevels;
+
+  // Parameter index of the weight of every link.
+  std::vector<ssize_t> aLinkParams;
+
+  // Weights read by Activate() instead of aLinkGenes, or NULL.
+  const double* aBoundWeights;
+
+  // Whether the plan below matches the neurons and links.
+  bool aCompiled;
+
+  // Neuron index and activation function of the target of every group.
+  std::vector<ssize_t> aPlanTargets;
+  std::vector<ActivationFuncType> aPlanFuncs;
+
+  // Links of group g are [aPlanOffsets[g], aPlanOffsets[g + 1]).
+  std::vector<ssize_t> aPlanOffsets;
+
+  // Source neuron index and weight of every link, in link order.
+  std::vector<ssize_t> aPlanSources;
+  std::vector<double> aPlanWeights;
+
+  // Parameter of the first link if the parameters of the links are
+  // consecutive, else -1.
+  ssize_t aParamOffset;
+
+  // Inputs and activations of all neurons during Activate().
+  std::vector<double> aInputs;
+  std::vector<double> aActivations;
+
+  // A fully connected layer: the links [firstLink, firstLink + numSources *
+  // numTargets) of numTargets consecutive groups with the same sources.
+  // The sources are the neurons [firstSource, firstSource + numSources), or
+  // firstSource is -1 if they are not consecutive. readsInputs is set if
+  // they are all input neurons.
+  struct DenseLayer {
+    ssize_t firstLink;
+    ssize_t numSources;
+    ssize_t numTargets;
+    ssize_t firstSource;
+    bool readsInputs;
+  };
+
+  // Layers of the plan, and the layer starting at every group, or -1.
+  std::vector<DenseLayer> aLayers;
+  std::vector<ssize_t> aPlanLayer;
+
+  // Indices of the nonzero inputs during Activate().
+  std::vector<ssize_t> aInputNonzeros;
+
+  // Gathered sources and products of a layer during Activate().
+  arma::vec aLayerIn;
+  arma::vec aLayerOut;
+
 };
 
 }  // namespace neuro_cmaes
@@ -0,0 +1,346 @@
+#ifndef MLPACK_METHODS_NEURO_CMAES_MAPPED_GENOME_HPP
+#define MLPACK_METHODS_NEURO_CMAES_MAPPED_GENOME_HPP
+
+/**
+ * @file mapped_genome.hpp
+ * @author www.github.com/Kartik-Nighania
+ *
+ * A binary file format for compiled genomes, and evaluation of such a file
+ * mapped into memory.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <mlpack/core.hpp>
+
+#include "genome.hpp"
+
+namespace mlpack {
+namespace neuro_cmaes {
+
+/**
+ * This class evaluates a genome saved with Save() straight from the file
+ * mapped into memory; only the inputs and activations of the neurons are
+ * allocated.
+ *
+ * The file holds the compiled plan of the genome in host byte order: a
+ * header, then the sections below, each an array of 8 byte values.
+ *
+ *  - neurons: id, type and activation function, depth of every neuron,
+ *  - groups: target neuron index and activation function of every group,
+ *  - offsets: links of group g are [offsets[g], offsets[g + 1]),
+ *  - sources: source neuron index of every link,
+ *  - params: parameter of every link, see Genome::LinkParam(),
+ *  - weights: weight of every link.
+ *
+ * The checksum of the header is the 64 bit FNV-1a hash, taken over 8 byte
+ * words, of the header with a zero checksum followed by the sections.
+ */
+class MappedGenome {
+ public:
+  // Map the file at path. Unless verify is false, the checksum, the indices
+  // and parameters of the plan and the neuron types and activation
+  // functions are checked; throws std::runtime_error if the file is not a
+  // valid genome.
+  MappedGenome(const std::string& path, bool verify = true) :
+      aData(NULL), aSize(0)
+  {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("MappedGenome(): cannot open " + path);
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < (off_t) sizeof(Header))
+    {
+      close(fd);
+      throw std::runtime_error("MappedGenome(): " + path +
+          " is not a genome file");
+    }
+
+    aSize = status.st_size;
+    void* data = mmap(NULL, aSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+      throw std::runtime_error("MappedGenome(): cannot map " + path);
+    aData = (const char*) data;
+
+    try
+    {
+      Attach(verify);
+    }
+    catch (...)
+    {
+      munmap((void*) aData, aSize);
+      throw;
+    }
+  }
+
+  // Destructor.
+  ~MappedGenome() { munmap((void*) aData, aSize); }
+
+  // Save the compiled plan of the genome with its current weights, see
+  // Genome::BindWeights(), to the file at path. The file is written next to
+  // path and renamed over it, so a failed save keeps the previous file.
+  static void Save(const std::string& path, Genome& genome) {
+    genome.Compile();
+
+    Header header;
+    std::memcpy(header.magic, Magic(), sizeof(header.magic));
+    header.version = kVersion;
+    header.numInput = genome.aNumInput;
+    header.numOutput = genome.aNumOutput;
+    header.numNeuron = genome.NumNeuron();
+    header.numLink = genome.NumLink();
+    header.numGroup = genome.aPlanTargets.size();
+    header.checksum = 0;
+
+    std::vector<int64_t> sections(SectionWords(header));
+    int64_t* out = sections.data();
+    for (ssize_t i=0; i<genome.NumNeuron(); ++i) {
+      const NeuronGene& neuron = genome.aNeuronGenes[i];
+      const double depth = neuron.Depth();
+      *out++ = neuron.Id();
+      *out++ = (int64_t) neuron.Type() << 32 | neuron.ActFuncType();
+      std::memcpy(out++, &depth, sizeof(depth));
+    }
+    for (int64_t g = 0; g < header.numGroup; ++g) {
+      *out++ = genome.aPlanTargets[g];
+      *out++ = genome.aPlanFuncs[g];
+    }
+    out = std::copy(genome.aPlanOffsets.begin(), genome.aPlanOffsets.end(),
+                    out);
+    out = std::copy(genome.aPlanSources.begin(), genome.aPlanSources.end(),
+                    out);
+    out = std::copy(genome.aLinkParams.begin(), genome.aLinkParams.end(),
+                    out);
+    std::memcpy(out, genome.LinkWeights(genome.aBoundWeights),
+                header.numLink * sizeof(double));
+    header.checksum = Checksum(header, sections.data(), sections.size());
+
+    const std::string tmpPath = path + ".tmp";
+    std::ofstream file(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+    file.write((const char*) &header, sizeof(header));
+    file.write((const char*) sections.data(),
+               sections.size() * sizeof(int64_t));
+    file.close();
+    if (!file || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+      std::remove(tmpPath.c_str());
+      throw std::runtime_error("MappedGenome::Save(): cannot write " + path);
+    }
+  }
+
+  // Get input length.
+  ssize_t NumInput() const { return aHeader->numInput; }
+
+  // Get output length.
+  ssize_t NumOutput() const { return aHeader->numOutput; }
+
+  // Get neuron number.
+  ssize_t NumNeuron() const { return aHeader->numNeuron; }
+
+  // Get link number.
+  ssize_t NumLink() const { return aHeader->numLink; }
+
+  // Get the weights of the links, in the mapped file.
+  const double* Weights() const { return aWeights; }
+
+  // Activate the genome, like Genome::Activate(). The neurons start with
+  // zero activations when the file is mapped.
+  void Activate(const std::vector<double>& input) {
+    assert(input.size() == (size_t) NumInput());
+
+    std::fill(aInputs.begin(), aInputs.end(), 0.0);
+    for (ssize_t i=0; i<NumInput(); ++i) {
+      aInputs[i] = input[i];
+      aActivations[i] = input[i];
+    }
+
+    double* activations = aActivations.data();
+    for (int64_t g = 0; g < aHeader->numGroup; ++g)
+    {
+      const int64_t toNeuronIdx = aGroups[2 * g];
+      double sum = aInputs[toNeuronIdx];
+      for (int64_t i = aOffsets[g]; i < aOffsets[g + 1]; ++i)
+        sum += activations[aSources[i]] * aWeights[i];
+      aInputs[toNeuronIdx] = sum;
+      NeuronGene::ActivationFunction((ActivationFuncType) aGroups[2 * g + 1],
+          &sum, activations + toNeuronIdx, 1);
+    }
+  }
+
+  // Get the output of the last Activate().
+  void Output(std::vector<double>& output) const {
+    output.assign(aActivations.begin() + NumInput(),
+                  aActivations.begin() + NumInput() + NumOutput());
+  }
+
+  // Rebuild the genome, with the saved weights in its links and the saved
+  // link parameters.
+  void ToGenome(Genome& genome) const {
+    std::vector<NeuronGene> neuronGenes;
+    for (ssize_t i=0; i<NumNeuron(); ++i) {
+      const int64_t* neuron = aNeurons + 3 * i;
+      double depth;
+      std::memcpy(&depth, neuron + 2, sizeof(depth));
+      neuronGenes.push_back(NeuronGene(neuron[0],
+          (NeuronType) (neuron[1] >> 32),
+          (ActivationFuncType) (neuron[1] & 0xffffffff), depth, 0, 0));
+    }
+
+    std::vector<LinkGene> linkGenes;
+    for (int64_t g = 0; g < aHeader->numGroup; ++g) {
+      const int64_t toNeuronId = aNeurons[3 * aGroups[2 * g]];
+      for (int64_t i = aOffsets[g]; i < aOffsets[g + 1]; ++i) {
+        linkGenes.push_back(LinkGene(aNeurons[3 * aSources[i]], toNeuronId,
+                                     aWeights[i]));
+      }
+    }
+
+    genome = Genome(neuronGenes, linkGenes, NumInput(), NumOutput());
+    for (ssize_t i=0; i<NumLink(); ++i)
+      genome.LinkParam(i, aParams[i]);
+  }
+
+ private:
+  // Not copyable, it owns the mapping.
+  MappedGenome(const MappedGenome&);
+  MappedGenome& operator=(const MappedGenome&);
+
+  // Start of every file.
+  struct Header {
+    char magic[8];
+    int64_t version;
+    int64_t numInput;
+    int64_t numOutput;
+    int64_t numNeuron;
+    int64_t numLink;
+    int64_t numGroup;
+    uint64_t checksum;
+  };
+
+  // Magic bytes and version of the format.
+  static const char* Magic() { return "NEUROGEN"; }
+  static const int64_t kVersion = 2;
+
+  // Number of 8 byte words of the sections of a file. The counts of the
+  // header must not be negative or larger than the words of the file.
+  static size_t SectionWords(const Header& header) {
+    return 3 * (size_t) header.numNeuron + 2 * (size_t) header.numGroup +
+        ((size_t) header.numGroup + 1) + 3 * (size_t) header.numLink;
+  }
+
+  // 64 bit FNV-1a hash of the header, with a zero checksum, and of the n
+  // words of the sections.
+  static uint64_t Checksum(const Header& header,
+                           const int64_t* words,
+                           size_t n) {
+    Header zeroed = header;
+    zeroed.checksum = 0;
+    int64_t headerWords[sizeof(Header) / sizeof(int64_t)];
+    std::memcpy(headerWords, &zeroed, sizeof(Header));
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < sizeof(Header) / sizeof(int64_t); ++i)
+      hash = (hash ^ (uint64_t) headerWords[i]) * 1099511628211ULL;
+    for (size_t i = 0; i < n; ++i)
+      hash = (hash ^ (uint64_t) words[i]) * 1099511628211ULL;
+    return hash;
+  }
+
+  // Check the mapped file and point the sections into it.
+  void Attach(bool verify) {
+    aHeader = (const Header*) aData;
+    const Header& header = *aHeader;
+    if (std::memcmp(header.magic, Magic(), sizeof(header.magic)) != 0 ||
+        header.version != kVersion)
+      throw std::runtime_error("MappedGenome(): not a genome file");
+
+    // No count can exceed the words of the file, which also keeps
+    // SectionWords() from overflowing.
+    const int64_t maxCount = aSize / sizeof(int64_t);
+    const int64_t counts[] = { header.numInput, header.numOutput,
+        header.numNeuron, header.numLink, header.numGroup };
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+    {
+      if (counts[i] < 0 || counts[i] > maxCount)
+        throw std::runtime_error("MappedGenome(): truncated genome file");
+    }
+
+    if (header.numInput + header.numOutput > header.numNeuron ||
+        header.numGroup > header.numLink ||
+        aSize != sizeof(Header) + SectionWords(header) * sizeof(int64_t))
+      throw std::runtime_error("MappedGenome(): truncated genome file");
+
+    const int64_t* words = (const int64_t*) (aData + sizeof(Header));
+    if (verify &&
+        Checksum(header, words, SectionWords(header)) != header.checksum)
+      throw std::runtime_error("MappedGenome(): checksum mismatch");
+
+    aNeurons = words;
+    aGroups = aNeurons + 3 * header.numNeuron;
+    aOffsets = aGroups + 2 * header.numGroup;
+    aSources = aOffsets + header.numGroup + 1;
+    aParams = aSources + header.numLink;
+    aWeights = (const double*) (aParams + header.numLink);
+
+    if (verify)
+    {
+      bool valid = aOffsets[0] == 0 && aOffsets[header.numGroup] ==
+          header.numLink;
+      for (int64_t i = 0; i < header.numNeuron && valid; ++i) {
+        const int64_t typeAndFunc = aNeurons[3 * i + 1];
+        valid = typeAndFunc >= 0 && (typeAndFunc >> 32) <= OUTPUT &&
+            (typeAndFunc & 0xffffffff) <= RELU;
+      }
+      for (int64_t g = 0; g < header.numGroup && valid; ++g) {
+        valid = aOffsets[g] <= aOffsets[g + 1] && aGroups[2 * g] >= 0 &&
+            aGroups[2 * g] < header.numNeuron && aGroups[2 * g + 1] >= 0 &&
+            aGroups[2 * g + 1] <= RELU;
+      }
+      for (int64_t i = 0; i < header.numLink && valid; ++i) {
+        valid = aSources[i] >= 0 && aSources[i] < header.numNeuron &&
+            aParams[i] >= 0;
+      }
+      if (!valid)
+        throw std::runtime_error("MappedGenome(): invalid plan");
+    }
+
+    aInputs.assign(header.numNeuron, 0.0);
+    aActivations.assign(header.numNeuron, 0.0);
+  }
+
+  // The mapped file.
+  const char* aData;
+  size_t aSize;
+
+  // Header and sections in the mapped file.
+  const Header* aHeader;
+  const int64_t* aNeurons;
+  const int64_t* aGroups;
+  const int64_t* aOffsets;
+  const int64_t* aSources;
+  const int64_t* aParams;
+  const double* aWeights;
+
+  // Inputs and activations of all neurons.
+  std::vector<double> aInputs;
+  std::vector<double> aActivations;
+};
+
+}  // namespace neuro_cmaes
+}  // namespace mlpack
+
+#endif  // MLPACK_METHODS_NEURO_CMAES_MAPPED_GENOME_HPP
@@ -0,0 +1,164 @@
+/**
+ * @file mapped_genome_test.cpp
+ * @author www.github.com/Kartik-Nighania
+ *
+ * Checks the file format of MappedGenome on the 170-6-5 network of the
+ * Super Mario Bros driver: a saved genome maps back with the same outputs
+ * and link parameters, and a file with a flipped byte or a truncated file
+ * is rejected.
+ *
+ * Usage: mapped_genome_test
+ *
+ * Writes mapped_genome_test.genome into the working directory and exits
+ * with 1 and names the failing case if a check failed.
+ */
+
+#include <mlpack/core.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "genome.hpp"
+#include "mapped_genome.hpp"
+
+using namespace mlpack::neuro_cmaes;
+
+namespace {
+
+//! The network of the driver: 169 inputs and a bias, 6 sigmoid hidden
+//! neurons fully connected to the inputs and 5 sigmoid outputs fully
+//! connected to the hidden neurons.
+Genome Network()
+{
+  std::vector<NeuronGene> neuronGenes;
+  std::vector<LinkGene> linkGenes;
+  for (size_t i = 0; i < 169; ++i)
+    neuronGenes.push_back(NeuronGene(i, INPUT, LINEAR, 0, 0, 0));
+  neuronGenes.push_back(NeuronGene(169, BIAS, LINEAR, 0, 0, 0));
+  for (size_t i = 170; i < 175; ++i)
+    neuronGenes.push_back(NeuronGene(i, OUTPUT, SIGMOID, 1, 0, 0));
+  for (size_t i = 175; i < 181; ++i)
+    neuronGenes.push_back(NeuronGene(i, HIDDEN, SIGMOID, 0.5, 0, 0));
+
+  for (size_t j = 175; j < 181; ++j)
+    for (size_t i = 0; i < 170; ++i)
+      linkGenes.push_back(LinkGene(i, j, 0));
+  for (size_t j = 175; j < 181; ++j)
+    for (size_t i = 170; i < 175; ++i)
+      linkGenes.push_back(LinkGene(j, i, 0));
+
+  Genome genome(neuronGenes, linkGenes, 170, 5);
+  genome.SortLinkGenes();
+  return genome;
+}
+
+//! Tile codes of a random frame, followed by the bias input.
+std::vector<double> Frame(std::mt19937& random)
+{
+  std::vector<double> input(170, 1.0);
+  for (size_t i = 0; i < 169; ++i)
+    input[i] = random() % 4;
+  return input;
+}
+
+//! Whether mapping the file at path throws std::runtime_error.
+bool Rejected(const std::string& path)
+{
+  try
+  {
+    MappedGenome mapped(path);
+  }
+  catch (const std::runtime_error&)
+  {
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+int main()
+{
+  const std::string path = "mapped_genome_test.genome";
+  std::mt19937 random(1);
+  std::normal_distribution<double> normal;
+
+  Genome genome = Network();
+  std::vector<double> weights(genome.NumParam());
+  for (size_t i = 0; i < weights.size(); ++i)
+    weights[i] = 0.5 + 0.3 * normal(random);
+  genome.BindWeights(weights.data());
+  MappedGenome::Save(path, genome);
+
+  bool passed = true;
+  {
+    // The mapped file and the genome rebuilt from it give the outputs of
+    // the genome, up to the order of the sums.
+    MappedGenome mapped(path);
+    Genome rebuilt;
+    mapped.ToGenome(rebuilt);
+
+    double maxError = 0, maxRebuiltError = 0;
+    std::vector<double> output, mappedOutput, rebuiltOutput;
+    for (int m = 0; m < 100; ++m)
+    {
+      std::vector<double> input = Frame(random);
+      genome.Activate(input);
+      mapped.Activate(input);
+      rebuilt.Activate(input);
+      genome.Output(output);
+      mapped.Output(mappedOutput);
+      rebuilt.Output(rebuiltOutput);
+      for (size_t i = 0; i < output.size(); ++i)
+      {
+        maxError = std::max(maxError, std::fabs(output[i] - mappedOutput[i]));
+        maxRebuiltError = std::max(maxRebuiltError,
+            std::fabs(output[i] - rebuiltOutput[i]));
+      }
+    }
+
+    bool sameParams = rebuilt.NumLink() == genome.NumLink();
+    for (ssize_t i = 0; i < genome.NumLink() && sameParams; ++i)
+      sameParams = rebuilt.LinkParam(i) == genome.LinkParam(i);
+
+    std::printf("round trip: max error mapped %g, rebuilt %g, link "
+        "parameters %s\n", maxError, maxRebuiltError,
+        sameParams ? "equal" : "differ");
+    passed = maxError <= 1e-12 && maxRebuiltError <= 1e-12 && sameParams;
+  }
+
+  // Flip one byte of the weights.
+  FILE* file = std::fopen(path.c_str(), "r+b");
+  std::fseek(file, -8, SEEK_END);
+  const int byte = std::fgetc(file);
+  std::fseek(file, -8, SEEK_END);
+  std::fputc(byte ^ 0x10, file);
+  std::fclose(file);
+  const bool flipped = Rejected(path);
+  std::printf("flipped byte: %s\n", flipped ? "rejected" : "accepted");
+
+  // Save the file again and cut off the weight of its last link.
+  MappedGenome::Save(path, genome);
+  file = std::fopen(path.c_str(), "rb");
+  std::fseek(file, 0, SEEK_END);
+  const long size = std::ftell(file);
+  std::fclose(file);
+  const bool truncated = truncate(path.c_str(), size - 8) == 0 &&
+      Rejected(path);
+  std::printf("truncated file: %s\n", truncated ? "rejected" : "accepted");
+
+  std::remove(path.c_str());
+  if (!passed || !flipped || !truncated)
+  {
+    std::printf("FAILED: the mapped genome does not match the saved one or a "
+        "damaged file was accepted\n");
+    return 1;
+  }
+  return 0;
+}
@@ -4,7 +4,14 @@
  *
  * Miscellaneous messages.
  */
+#ifndef MESSAGES_HPP
+#define MESSAGES_HPP
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
 #include <string>
+#include <vector>
 
 namespace messages {
 
@@ -114,6 +121,140 @@ static inline std::string GetEndpoint()
 
 
 
+//! Create message to register a worker with the master, telling whether
+//! the worker keeps a replica of the optimizer.
+static inline std::string RegisterWorker(const std::string& name,
+                                         const bool replica)
+{
+  return "\"register\":{\"name\": \"" + name + "\", \"replica\": " +
+      (replica ? "true" : "false") + "}";
+}
+
+//! Create message to send the id assigned to a worker.
+static inline std::string WorkerId(const int id)
+{
+  return "\"worker\":{\"id\": " + std::to_string(id) + "}";
+}
+
+//! Create message to request the next evaluation task.
+static inline std::string RequestTask(const int worker)
+{
+  return "\"request\":{\"worker\": " + std::to_string(worker) + "}";
+}
+
+//! Format a number for JSON, which has no inf or nan: nan and +inf are
+//! sent as the largest double and -inf as the lowest, so a failed
+//! evaluation still reaches the master as the worst fitness.
+static inline std::string Number(double x)
+{
+  if (std::isnan(x) || x > DBL_MAX)
+    x = DBL_MAX;
+  else if (x < -DBL_MAX)
+    x = -DBL_MAX;
+
+  char value[32];
+  snprintf(value, sizeof(value), "%.17g", x);
+  return value;
+}
+
+//! Create a JSON array of the given numbers.
+static inline std::string Array(const double* x, const int n)
+{
+  std::string array = "[";
+
+  for (int i = 0; i < n; ++i)
+  {
+    if (i > 0) array += ",";
+    array += Number(x[i]);
+  }
+
+  return array + "]";
+}
+
+//! Create message to send a candidate solution that should be evaluated.
+static inline std::string Task(const int generation,
+                               const int index,
+                               const double* x,
+                               const int n)
+{
+  return "\"task\":{\"generation\": " + std::to_string(generation) +
+      ", \"index\": " + std::to_string(index) + ", \"x\": " + Array(x, n) +
+      "}";
+}
+
+//! Create message to send a candidate that the worker samples itself.
+static inline std::string SeedTask(const int generation, const int index)
+{
+  return "\"seedtask\":{\"generation\": " + std::to_string(generation) +
+      ", \"index\": " + std::to_string(index) + "}";
+}
+
+//! Create message to request the fitness values of a past generation.
+static inline std::string History(const int worker, const int generation)
+{
+  return "\"history\":{\"worker\": " + std::to_string(worker) +
+      ", \"generation\": " + std::to_string(generation) + "}";
+}
+
+//! Create message to send the fitness values of count past generations,
+//! starting with the given generation.
+static inline std::string Fitness(const int generation,
+                                  const std::vector<double>* values,
+                                  const int count)
+{
+  std::string arrays = "[";
+  for (int i = 0; i < count; ++i)
+  {
+    if (i > 0) arrays += ",";
+    arrays += Array(values[i].data(), values[i].size());
+  }
+
+  return "\"fitness\":{\"generation\": " + std::to_string(generation) +
+      ", \"values\": " + arrays + "]}";
+}
+
+//! Create message to send the fitness of an evaluated task.
+static inline std::string Result(const int worker,
+                                 const int generation,
+                                 const int index,
+                                 const double fitness)
+{
+  return "\"result\":{\"worker\": " + std::to_string(worker) +
+      ", \"generation\": " + std::to_string(generation) +
+      ", \"index\": " + std::to_string(index) +
+      ", \"fitness\": " + Number(fitness) + "}";
+}
+
+//! Create message to signal that a worker is still alive.
+static inline std::string Heartbeat(const int worker)
+{
+  return "\"heartbeat\":{\"worker\": " + std::to_string(worker) + "}";
+}
+
+//! Create message to tell a worker that there is no task right now.
+static inline std::string Wait()
+{
+  return "\"wait\":{}";
+}
+
+//! Create message to tell a worker to shut down.
+static inline std::string Stop()
+{
+  return "\"stop\":{}";
+}
+
+//! Create message to turn away a worker that cannot evaluate the tasks.
+static inline std::string Reject(const std::string& reason)
+{
+  return "\"reject\":{\"reason\": \"" + reason + "\"}";
+}
+
+//! Create message to acknowledge a message.
+static inline std::string Ack()
+{
+  return "\"ack\":{}";
+}
+
 //! Function to append a JSON message to JSON another message.
 static inline void Append(std::string& messageA, const std::string& messageB)
 {
@@ -133,4 +274,6 @@ static inline std::string JSONMessage(const std::string& messageA)
   return "{" + messageA + "}";
 }
 
-} // namespace messages
\ No newline at end of file
+} // namespace messages
+
+#endif
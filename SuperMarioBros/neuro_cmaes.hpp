@@ -10,22 +10,29 @@
 
 #include <cstddef>
 #include <mlpack/core.hpp>
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdarg>
 #include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <limits>
 #include <iomanip>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 
+#include "arena.hpp"
 #include "genome.hpp"
 #include "neuron_gene.hpp"
 #include "link_gene.hpp"
 #include "parameters.hpp"
 #include "random.hpp"
+#include "stats.hpp"
+#include "symmetric_eigen.hpp"
+#include "thread_pool.hpp"
 #include "utils.hpp"
 
 
@@ -43,20 +50,20 @@ public:
 
 T axisRatio()
 {
- return maxElement(rgD, params.N) / minElement(rgD, params.N);
+ return maxElement(rgD, params->N) / minElement(rgD, params->N);
 };
 
 T evaluation(){ return countevals; }
 
 T fitness(){ return functionValues[index[0]];}
 
-T fitnessBestEver(){ return xBestEver[params.N];}
+T fitnessBestEver(){ return xBestEver[params->N];}
 
 T generation(){ return gen;}
 
-T maxEvaluation(){ return params.stopMaxFunEvals;}
+T maxEvaluation(){ return params->stopMaxFunEvals;}
 
-T maxIteration(){ return std::ceil(params.stopMaxIter); }
+T maxIteration(){ return std::ceil(params->stopMaxIter); }
 
 T maxAxisLength(){ return sigma*std::sqrt(maxEW);}
 
@@ -66,16 +73,20 @@ T maxStdDev(){return sigma*std::sqrt(maxdiagC);}
 
 T minStdDev(){return sigma*std::sqrt(mindiagC);}
 
-T dimension(){return params.N;}
+T dimension(){return params->N;}
 
-T sampleSize(){return params.lambda;}
+T sampleSize(){return params->lambda;}
 
 T sigmaValue(){return sigma;}
 
+int eigenCheckFailures(){return eigenFailures;}
+
+unsigned long randomSeed(){return seed;}
+
   T* diagonalCovariance()
   {
-     for(int i = 0; i < params.N; ++i)
-          output[i] = C[i][i];
+     for(int i = 0; i < params->N; ++i)
+          output[i] = diagC(i);
         return output;
   }
 
@@ -83,8 +94,8 @@ T sigmaValue(){return sigma;}
 
   T* standardDeviation()
   {
-    for(int i = 0; i < params.N; ++i)
-          output[i] = sigma*std::sqrt(C[i][i]);
+    for(int i = 0; i < params->N; ++i)
+          output[i] = sigma*std::sqrt(diagC(i));
         return output;
   }
 
@@ -94,31 +105,104 @@ T* XBest(){return population[index[0]];}
 
 T* XMean(){return xmean;}
 
+  /**
+   * The population of the last samplePopulation() as N x lambda matrix, one
+   * offspring per column, over the memory of the engine. Valid until the
+   * next init(); do not resize it.
+   */
+  arma::Mat<T> populationMatrix()
+  {
+    return arma::Mat<T>(population[0], params->N, params->lambda, false, true);
+  }
+
+  //! The distribution mean as vector over the memory of the engine.
+  arma::Col<T> meanVector()
+  {
+    return arma::Col<T>(xmean, params->N, false, true);
+  }
+
+  //! Number of diagonal blocks of the covariance matrix.
+  int covarianceBlocks(){ return numBlocks; }
+
+  /**
+   * A diagonal block of the covariance matrix over the memory of the engine,
+   * the whole matrix unless Parameters::blockSizes is set. Its rows are
+   * padded to whole cache lines, so for a block of n coordinates this is a
+   * paddedLength(n) x n matrix whose first n rows hold the block, e.g.
+   * covarianceMatrix().rows(0, n - 1). C is symmetric, so the column-major
+   * view equals the row-major storage.
+   */
+  arma::Mat<T> covarianceMatrix(const int block = 0)
+  {
+    const int n = blockStart[block + 1] - blockStart[block];
+    return arma::Mat<T>(C[blockStart[block]], paddedLength<T>(n), n, false,
+        true);
+  }
+
+  /**
+   * The fitness array returned by init() as row vector over the memory of
+   * the engine.
+   */
+  arma::Row<T> fitnessVector()
+  {
+    return arma::Row<T>(publicFitness, params->lambda, false, true);
+  }
+
 private:
 
-  //!< Random number generator.
-  Random<T> rand;
-  //!< CMA-ES parameters.
-  Parameters<T> params;
+  //!< Counter-based random number generator, see samplePopulation().
+  CounterRandom<T> rand;
+  //! Seed of rand.
+  unsigned long seed;
+  //! Number of addMutation() calls in the current generation.
+  int extraDraws;
+  //!< CMA-ES parameters, possibly shared with other instances.
+  SharedParameters<T> params;
+  //! Owns all arrays below, which are carved out of it by carve().
+  Arena arena;
+  //! Threads of samplePopulation() and updateDistribution(), NULL if only
+  //! the caller works.
+  std::unique_ptr<ThreadPool> pool;
 
   //! Step size.
   T sigma;
   //! Mean x vector, "parent".
   T* xmean;
-  //! Best sample ever.
+  //! Best sample ever, followed by its fitness and evaluation count.
   T* xBestEver;
-  //! x-vectors, lambda offspring.
+  //! x-vectors, lambda offspring, stored contiguously N apart.
   T** population;
   //! Sorting index of sample population.
   int* index;
   //! History of function values.
   T* funcValueHistory;
+  //! Length of funcValueHistory.
+  int historySize;
 
   T chiN;
-  //! Lower triangular matrix: i>=j for C[i][j].
+  //! Length of a vector of N, padded to a whole number of cache lines.
+  int rowStride;
+  //! Number of diagonal blocks of C, see Parameters::blockSizes.
+  int numBlocks;
+  //! First coordinate of every block, followed by N.
+  int* blockStart;
+  //! Block of every coordinate.
+  int* rowBlock;
+  //! Blocks by decreasing size, the order in which threads pick them up.
+  int* blockOrder;
+  //! Outcome of the last decomposition of every block, see decomposeBlock().
+  int* blockStatus;
+  /**
+   * Symmetric block diagonal covariance matrix. Row i only holds the columns
+   * of its block, C[i][j - blockStart[b]] for j in block b; the rows of a
+   * block are padded to whole cache lines and follow each other in one
+   * aligned array.
+   */
   T** C;
-  //! Matrix with normalize eigenvectors in columns.
+  //! Matrix with normalize eigenvectors in columns, stored like C.
   T** B;
+  //! Scaled steps (x_k - xold) / sigma of the mu best offspring, mu rows.
+  T* selectedSteps;
   //! Axis lengths.
   T* rgD;
 
@@ -132,8 +216,14 @@ private:
   T* output;
   //! B*D*z.
   T* BDz;
-  //! Temporary (random) vector used in different places.
+  //! Temporary (random) vector used in different places, N + numBlocks.
   T* tempRandom;
+  //! Scaled random vector of samplePopulation(), one row per thread.
+  T* sampleScratch;
+  //! Returned by sampleSingleInto() and perturbSolutionInto() for x == NULL.
+  T* sampleBuffer;
+  //! Probe vector and product of verifyEigen(), 2*N.
+  T* probeBuffer;
   //! Objective function values of the population.
   T* functionValues;
   //!< Public objective function value array returned by init().
@@ -152,70 +242,101 @@ private:
 
   bool eigensysIsUptodate;
   bool doCheckEigen; //!< control via signals.par
+  //! Number of eigendecompositions, for Parameters::eigenCheckInterval.
+  int eigenDecompositions;
+  //! Number of block decompositions rejected by verifyEigen().
+  int eigenFailures;
   T genOfEigensysUpdate;
+  //! Generations between eigendecompositions, updateCmode.modulo shortened
+  //! by the larger learning rates of small blocks, see adaptC2().
+  T eigenModulo;
 
   T dMaxSignifKond;
   T dLastMinEWgroesserNull;
 
   std::string stopMessage; //!< A message that contains all matched stop criteria.
 
+  //! Phase timings, only recorded if NEURO_CMAES_STATS is defined.
+  CMAESStats stats;
+
   /**
-   * Calculating eigenvalues and vectors.
-   * @param rgtmp (input) N+1-dimensional vector for temporal use.
-   * @param diag (output) N eigenvalues.
-   * @param Q (output) Columns are normalized eigenvectors.
+   * Appends one printf style line to stopMessage. The capacity of stopMessage
+   * is reserved in init(), so this does not allocate in the common case.
    */
-  void eigen(T* diag, T** Q, T* rgtmp)
+  void appendStopMessage(const char* format, ...)
   {
-    assert(rgtmp && "eigen(): input parameter rgtmp must be non-NULL");
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    stopMessage += line;
+    stopMessage += '\n';
+  }
+
+  /**
+   * Calculating eigenvalues and vectors of block b of C.
+   * @param b Block of C, decomposed into the same rows of B and rgD.
+   * @param shift Added to the diagonal of the block before decomposing it.
+   */
+  void eigen(const int b, const T shift = T(0))
+  {
+    const int o = blockStart[b];
+    const int n = blockStart[b + 1] - o;
 
-    if(C != Q) // copy C to Q
+    // copy C + shift*I to B
+    for(int i = o; i < o + n; ++i)
     {
-      for(int i = 0; i < params.N; ++i)
-        for(int j = 0; j <= i; ++j)
-          Q[i][j] = Q[j][i] = C[i][j];
+      std::copy(C[i], C[i] + n, B[i]);
+      B[i][i - o] += shift;
     }
 
-    householder(Q, diag, rgtmp);
-    ql(diag, rgtmp, Q);
+    // every block needs n + 1 temporary elements
+    symmetricEigen(B + o, rgD + o, tempRandom + o + b, n);
   }
 
   /**
-   * Exhaustive test of the output of the eigendecomposition, needs O(n^3)
-   * operations writes to error file.
+   * Exhaustive test of the output of the eigendecomposition of block b,
+   * needs O(n^3) operations writes to error file.
    * @return number of detected inaccuracies
    */
-  int checkEigen(T* diag, T** Q)
+  int checkEigen(const int b)
   {
+    const int o = blockStart[b];
+    const int n = blockStart[b + 1] - o;
+    const T* diag = rgD + o;
+    T* const* Q = B + o;
+    T* const* Cb = C + o;
+
     // compute Q diag Q^T and Q Q^T to check
     int res = 0;
-    for(int i = 0; i < params.N; ++i)
-      for(int j = 0; j < params.N; ++j) {
+    for(int i = 0; i < n; ++i)
+      for(int j = 0; j < n; ++j) {
         T cc = 0., dd = 0.;
-        for(int k = 0; k < params.N; ++k)
+        for(int k = 0; k < n; ++k)
         {
           cc += diag[k]*Q[i][k]*Q[j][k];
           dd += Q[i][k]*Q[j][k];
         }
         // check here, is the normalization the right one?
-        const bool cond1 = fabs(cc - C[i > j ? i : j][i > j ? j : i]) / sqrt(C[i][i]* C[j][j]) > T(1e-10);
-        const bool cond2 = fabs(cc - C[i > j ? i : j][i > j ? j : i]) > T(3e-14);
+        const bool cond1 = fabs(cc - Cb[i][j]) / sqrt(Cb[i][i]* Cb[j][j]) > T(1e-10);
+        const bool cond2 = fabs(cc - Cb[i][j]) > T(3e-14);
         if(cond1 && cond2)
         {
           std::stringstream s;
-          s << i << " " << j << ": " << cc << " " << C[i > j ? i : j][i > j ? j : i]
-              << ", " << cc - C[i > j ? i : j][i > j ? j : i];
-          if(params.logWarnings)
-            params.logStream << "eigen(): imprecise result detected " << s.str()
+          s << o + i << " " << o + j << ": " << cc << " " << Cb[i][j]
+              << ", " << cc - Cb[i][j];
+          if(params->logWarnings)
+            params->logStream << "eigen(): imprecise result detected " << s.str()
                 << std::endl;
           ++res;
         }
         if(std::fabs(dd - (i == j)) > T(1e-10))
         {
           std::stringstream s;
-          s << i << " " << j << " " << dd;
-          if(params.logWarnings)
-            params.logStream << "eigen(): imprecise result detected (Q not orthog.)"
+          s << o + i << " " << o + j << " " << dd;
+          if(params->logWarnings)
+            params->logStream << "eigen(): imprecise result detected (Q not orthog.)"
                 << s.str() << std::endl;
           ++res;
         }
@@ -223,228 +344,110 @@ private:
     return res;
   }
 
-  void ql(T* d, T* e, T** V)
+  /**
+   * Randomized test of the output of the eigendecomposition of block b,
+   * needs O(k*n^2) operations for k = eigenCheckProbes. Compares C*v with
+   * Q*diag(diag)*Q^T*v for k random vectors v, and the inner products of k
+   * random pairs of columns of Q with the identity.
+   * @return Whether all residuals are below eigenCheckTolerance.
+   */
+  bool verifyEigen(const int b)
   {
-    const int n = params.N;
-    T f(0);
-    T tst1(0);
-    const T eps(2.22e-16); // 2.0^-52.0 = 2.22e-16
-
-    // shift input e
-    T* ep1 = e;
-    for(T *ep2 = e+1, *const end = e+n; ep2 != end; ep1++, ep2++)
-      *ep1 = *ep2;
-    *ep1 = T(0); // never changed again
-
-    for(int l = 0; l < n; l++)
+    const int o = blockStart[b];
+    const int n = blockStart[b + 1] - o;
+    const T* diag = rgD + o;
+    T* const* Q = B + o;
+    T* const* Cb = C + o;
+    T* v = probeBuffer + 2*o;
+    T* u = v + n;
+    T w[2];
+
+    // the probes are drawn from their own family of streams, two per probe
+    // and block
+    const uint64_t stream = (uint64_t(1) << 63) | (uint64_t) gen;
+    const uint64_t first = 2*(uint64_t) b*params->eigenCheckProbes;
+    const T scale = std::max(std::fabs(maxElement(diag, n)),
+        std::fabs(minElement(diag, n)));
+
+    for(int k = 0; k < params->eigenCheckProbes; ++k)
     {
-      // find small subdiagonal element
-      T& el = e[l];
-      T& dl = d[l];
-      const T smallSDElement = std::fabs(dl) + std::fabs(el);
-      if(tst1 < smallSDElement)
-        tst1 = smallSDElement;
-      const T epsTst1 = eps*tst1;
-      int m = l;
-      while(m < n)
-      {
-        if(std::fabs(e[m]) <= epsTst1) break;
-        m++;
-      }
+      rand.gauss(stream, first + 2*k, v, n);
 
-      // if m == l, d[l] is an eigenvalue, otherwise, iterate.
-      if(m > l)
+      // u = diag*Q^T*v
+      std::fill(u, u + n, T(0));
+      for(int i = 0; i < n; ++i)
       {
-        do {
-          T h, g = dl;
-          T& dl1r = d[l+1];
-          T p = (dl1r - g) / (T(2)*el);
-          T r = myhypot(p, T(1));
-
-          // compute implicit shift
-          if(p < 0) r = -r;
-          const T pr = p+r;
-          dl = el/pr;
-          h = g - dl;
-          const T dl1 = el*pr;
-          dl1r = dl1;
-          for(int i = l+2; i < n; i++) d[i] -= h;
-          f += h;
-
-          // implicit QL transformation.
-          p = d[m];
-          T c(1);
-          T c2(1);
-          T c3(1);
-          const T el1 = e[l+1];
-          T s(0);
-          T s2(0);
-          for(int i = m-1; i >= l; i--)
-          {
-            c3 = c2;
-            c2 = c;
-            s2 = s;
-            const T& ei = e[i];
-            g = c*ei;
-            h = c*p;
-            r = myhypot(p, ei);
-            e[i+1] = s*r;
-            s = ei/r;
-            c = p/r;
-            const T& di = d[i];
-            p = c*di - s*g;
-            d[i+1] = h + s*(c*g + s*di);
-
-            // accumulate transformation.
-            for(int k = 0; k < n; k++)
-            {
-              T& Vki1 = V[k][i+1];
-              h = Vki1;
-              T& Vki = V[k][i];
-              Vki1 = s*Vki + c*h;
-              Vki *= c; Vki -= s*h;
-            }
-          }
-          p = -s*s2*c3*el1*el/dl1;
-          el = s*p;
-          dl = c*p;
-        } while(std::fabs(el) > epsTst1);
+        const T* Qi = Q[i];
+        const T vi = v[i];
+        for(int j = 0; j < n; ++j)
+          u[j] += Qi[j]*vi;
       }
-      dl += f;
-      el = 0.0;
-    }
-  }
-
-  void householder(T** V, T* d, T* e)
-  {
-    const int n = params.N;
+      for(int j = 0; j < n; ++j)
+        u[j] *= diag[j];
 
-    for(int j = 0; j < n; j++)
-    {
-      d[j] = V[n - 1][j];
-    }
-
-    // Householder reduction to tridiagonal form
-
-    for(int i = n - 1; i > 0; i--)
-    {
-      // scale to avoid under/overflow
-      T scale = 0.0;
-      T h = 0.0;
-      for(T *pd = d, *const dend = d+i; pd != dend; pd++)
-      {
-        scale += std::fabs(*pd);
-      }
-      if(scale == 0.0)
+      // residual C*v - Q*u
+      T residual(0), norm(0);
+      for(int i = 0; i < n; ++i)
       {
-        e[i] = d[i-1];
-        for(int j = 0; j < i; j++)
+        const T* Ci = Cb[i];
+        const T* Qi = Q[i];
+        T cv(0), qu(0);
+        for(int j = 0; j < n; ++j)
         {
-          d[j] = V[i-1][j];
-          V[i][j] = 0.0;
-          V[j][i] = 0.0;
+          cv += Ci[j]*v[j];
+          qu += Qi[j]*u[j];
         }
+        residual += square(cv - qu);
+        norm += square(v[i]);
       }
-      else
-      {
-        // generate Householder vector
-        for(T *pd = d, *const dend = d+i; pd != dend; pd++)
-        {
-          *pd /= scale;
-          h += *pd * *pd;
-        }
-        T& dim1 = d[i-1];
-        T f = dim1;
-        T g = f > 0 ? -std::sqrt(h) : std::sqrt(h);
-        e[i] = scale*g;
-        h = h - f* g;
-        dim1 = f - g;
-        memset((void *) e, 0, (size_t)i*sizeof(T));
-
-        // apply similarity transformation to remaining columns
-        for(int j = 0; j < i; j++)
-        {
-          f = d[j];
-          V[j][i] = f;
-          T& ej = e[j];
-          g = ej + V[j][j]* f;
-          for(int k = j + 1; k <= i - 1; k++)
-          {
-            T& Vkj = V[k][j];
-            g += Vkj*d[k];
-            e[k] += Vkj*f;
-          }
-          ej = g;
-        }
-        f = 0.0;
-        for(int j = 0; j < i; j++)
-        {
-          T& ej = e[j];
-          ej /= h;
-          f += ej* d[j];
-        }
-        T hh = f / (h + h);
-        for(int j = 0; j < i; j++)
-        {
-          e[j] -= hh*d[j];
-        }
-        for(int j = 0; j < i; j++)
-        {
-          T& dj = d[j];
-          f = dj;
-          g = e[j];
-          for(int k = j; k <= i - 1; k++)
-          {
-            V[k][j] -= f*e[k] + g*d[k];
-          }
-          dj = V[i-1][j];
-          V[i][j] = 0.0;
-        }
-      }
-      d[i] = h;
+      if(!(std::sqrt(residual) <= params->eigenCheckTolerance*scale*
+          std::sqrt(norm)))
+        return false;
+
+      // orthonormality of a random pair of columns
+      rand.uniform(stream, first + 2*k + 1, w, 2);
+      const int a = std::min(n - 1, (int) (w[0]*n));
+      const int c = std::min(n - 1, (int) (w[1]*n));
+      T dot(0);
+      for(int i = 0; i < n; ++i)
+        dot += Q[i][a]*Q[i][c];
+      if(!(std::fabs(dot - (a == c)) <= params->eigenCheckTolerance))
+        return false;
     }
+    return true;
+  }
 
-    // accumulate transformations
-    const int nm1 = n-1;
-    for(int i = 0; i < nm1; i++)
-    {
-      T h;
-      T& Vii = V[i][i];
-      V[n-1][i] = Vii;
-      Vii = 1.0;
-      h = d[i+1];
-      if(h != 0.0)
-      {
-        for(int k = 0; k <= i; k++)
-        {
-          d[k] = V[k][i+1] / h;
-        }
-        for(int j = 0; j <= i; j++) {
-          T g = 0.0;
-          for(int k = 0; k <= i; k++)
-          {
-            T* Vk = V[k];
-            g += Vk[i+1]* Vk[j];
-          }
-          for(int k = 0; k <= i; k++)
-          {
-            V[k][j] -= g*d[k];
-          }
-        }
-      }
-      for(int k = 0; k <= i; k++)
-      {
-        V[k][i+1] = 0.0;
-      }
-    }
-    for(int j = 0; j < n; j++)
+  /**
+   * Decomposes block b of C, see eigen(). If check is set, the result is
+   * verified with verifyEigen(); a rejected decomposition is repeated with
+   * the diagonal of C shifted by 1e-12 times its largest element, which
+   * separates nearly equal eigenvalues, and if that fails too the diagonal
+   * of C is used.
+   * @return 0 if the decomposition was accepted, 1 if it was accepted with
+   *         the shifted diagonal and 2 if the diagonal of C is used.
+   */
+  int decomposeBlock(const int b, const bool check)
+  {
+    eigen(b);
+    if(!check || verifyEigen(b))
+      return 0;
+
+    const int o = blockStart[b];
+    const int n = blockStart[b + 1] - o;
+    T maxDiag(0);
+    for(int i = 0; i < n; ++i)
+      maxDiag = std::max(maxDiag, C[o + i][i]);
+    eigen(b, T(1e-12)*maxDiag);
+    if(verifyEigen(b))
+      return 1;
+
+    for(int i = 0; i < n; ++i)
     {
-      T& Vnm1j = V[n-1][j];
-      d[j] = Vnm1j;
-      Vnm1j = 0.0;
+      std::fill(B[o + i], B[o + i] + n, T(0));
+      B[o + i][i] = T(1);
+      rgD[o + i] = C[o + i][i];
     }
-    V[n-1][n-1] = 1.0;
-    e[0] = 0.0;
+    return 2;
   }
 
   /**
@@ -467,40 +470,103 @@ private:
 
   void adaptC2(const int hsig)
   {
-    const int N = params.N;
-    bool diag = params.diagonalCov == 1 || params.diagonalCov >= gen;
+    NEURO_CMAES_TIME(adaptC2);
+    const int N = params->N;
+    bool diag = params->diagonalCov == 1 || params->diagonalCov >= gen;
 
-    if(params.ccov != T(0))
+    if(params->ccov != T(0))
     {
       // definitions for speeding up inner-most loop
-      const T mucovinv = T(1)/params.mucov;
-      const T commonFactor = params.ccov * (diag ? (N + T(1.5)) / T(3) : T(1));
-      const T ccov1 = std::min(commonFactor*mucovinv, T(1));
-      const T ccovmu = std::min(commonFactor*(T(1)-mucovinv), T(1)-ccov1);
-      const T sigmasquare = sigma*sigma;
-      const T onemccov1ccovmu = T(1)-ccov1-ccovmu;
-      const T longFactor = (T(1)-hsig)*params.ccumcov*(T(2)-params.ccumcov);
+      const T mucovinv = T(1)/params->mucov;
+      const T sigmainv = T(1)/sigma;
+      const T longFactor = (T(1)-hsig)*params->ccumcov*(T(2)-params->ccumcov);
 
       eigensysIsUptodate = false;
 
-      // update covariance matrix
-      for(int i = 0; i < N; ++i)
-        for(int j = diag ? i : 0; j <= i; ++j)
+      // scaled steps of the selected offspring, one contiguous row each
+      forRows(N, FLAT, [&](const int i0, const int i1)
+      {
+        for(int k = 0; k < params->mu; ++k)
+        {
+          const T* rgrgxindexk = population[index[k]];
+          T* yk = selectedSteps + k*rowStride;
+          for(int i = i0; i < i1; ++i)
+            yk[i] = (rgrgxindexk[i] - xold[i])*sigmainv;
+        }
+      });
+
+      // update the lower triangle of rows [i0, i1) of block b; the learning
+      // rates grow with the fewer degrees of freedom of a diagonal C or of
+      // smaller blocks
+      auto updateRows = [&](const int b, const int i0, const int i1)
+      {
+        const int o = blockStart[b];
+        const T commonFactor = params->ccov * (diag ? (N + T(1.5)) / T(3) :
+            numBlocks > 1 ? (N + T(1.5)) / (blockStart[b + 1] - o + T(2)) :
+            T(1));
+        const T ccov1 = std::min(commonFactor*mucovinv, T(1));
+        const T ccovmu = std::min(commonFactor*(T(1)-mucovinv), T(1)-ccov1);
+        const T onemccov1ccovmu = T(1)-ccov1-ccovmu;
+        const T decay = onemccov1ccovmu + ccov1*longFactor;
+
+        for(int i = i0; i < i1; ++i)
         {
-          T& Cij = C[i][j];
-          Cij = onemccov1ccovmu*Cij + ccov1 * (pc[i]*pc[j] + longFactor*Cij);
-          for(int k = 0; k < params.mu; ++k)
+          T* Ci = C[i];
+          const int j0 = diag ? i : o;
+          const T pci = ccov1*pc[i];
+          for(int j = j0; j <= i; ++j)
+            Ci[j - o] = decay*Ci[j - o] + pci*pc[j];
+          for(int k = 0; k < params->mu; ++k)
           { // additional rank mu update
-            const T* rgrgxindexk = population[index[k]];
-            Cij += ccovmu*params.weights[k] * (rgrgxindexk[i] - xold[i])
-                * (rgrgxindexk[j] - xold[j]) / sigmasquare;
+            const T* yk = selectedSteps + k*rowStride;
+            const T f = ccovmu*params->weights[k]*yk[i];
+            for(int j = j0; j <= i; ++j)
+              Ci[j - o] += f*yk[j];
           }
         }
+      };
+
+      // one block is split by rows, several blocks are spread over the
+      // threads as a whole
+      if(numBlocks == 1)
+        forRows(N, diag ? FLAT : LOWER, [&](const int i0, const int i1)
+        {
+          updateRows(0, i0, i1);
+        });
+      else
+        forBlocks([&](const int b)
+        {
+          updateRows(b, blockStart[b], blockStart[b + 1]);
+        });
+
+      // mirror into the upper triangle, by rows of the upper triangle
+      if(!diag)
+      {
+        auto mirrorRows = [&](const int b, const int i0, const int i1)
+        {
+          const int o = blockStart[b];
+          const int n = blockStart[b + 1] - o;
+          for(int i = i0 - o; i < i1 - o; ++i)
+            for(int j = i + 1; j < n; ++j)
+              C[o + i][j] = C[o + j][i];
+        };
+        if(numBlocks == 1)
+          forRows(N, UPPER, [&](const int i0, const int i1)
+          {
+            mirrorRows(0, i0, i1);
+          });
+        else
+          forBlocks([&](const int b)
+          {
+            mirrorRows(b, blockStart[b], blockStart[b + 1]);
+          });
+      }
+
       // update maximal and minimal diagonal value
-      maxdiagC = mindiagC = C[0][0];
+      maxdiagC = mindiagC = diagC(0);
       for(int i = 1; i < N; ++i)
       {
-        const T& Cii = C[i][i];
+        const T& Cii = diagC(i);
         if(maxdiagC < Cii)
           maxdiagC = Cii;
         else if(mindiagC > Cii)
@@ -514,73 +580,221 @@ private:
    */
   void testMinStdDevs(void)
   {
-    if(!this->params.rgDiffMinChange)
+    NEURO_CMAES_TIME(minStdDevs);
+    if(!this->params->rgDiffMinChange)
       return;
 
-    for(int i = 0; i < params.N; ++i)
-      while(this->sigma*std::sqrt(this->C[i][i]) < this->params.rgDiffMinChange[i])
-        this->sigma *= std::exp(T(0.05) + this->params.cs / this->params.damps);
+    for(int i = 0; i < params->N; ++i)
+      while(this->sigma*std::sqrt(diagC(i)) < this->params->rgDiffMinChange[i])
+        this->sigma *= std::exp(T(0.05) + this->params->cs / this->params->damps);
   }
 
   /**
-   * Adds the mutation sigma*B*(D*z).
+   * Adds the mutation sigma*B*(D*z). The k-th call in generation g draws z
+   * from stream (g, lambda + k), after the offspring streams.
    * @param x Search space vector.
    * @param eps Mutation factor.
    */
   void addMutation(T* x, T eps = 1.0)
   {
-    for(int i = 0; i < params.N; ++i)
-      tempRandom[i] = rgD[i]*rand.gauss();
-    for(int i = 0; i < params.N; ++i)
+    rand.gauss((uint64_t) gen, params->lambda + extraDraws++, tempRandom,
+        params->N);
+    for(int i = 0; i < params->N; ++i)
+      tempRandom[i] *= rgD[i];
+    for(int i = 0; i < params->N; ++i)
+      x[i] = xmean[i] + eps*sigma*rowTimesB(i, tempRandom);
+  }
+
+  //! Diagonal element i of C.
+  T& diagC(const int i)
+  {
+    return C[i][i - blockStart[rowBlock[i]]];
+  }
+
+  //! Row i of B times the N-dimensional vector x, over the block of row i.
+  T rowTimesB(const int i, const T* x) const
+  {
+    const int b = rowBlock[i];
+    const int o = blockStart[b];
+    const int n = blockStart[b + 1] - o;
+    const T* Bi = B[i];
+    const T* xb = x + o;
+    T sum = 0.0;
+    for(int j = 0; j < n; ++j)
+      sum += Bi[j]*xb[j];
+    return sum;
+  }
+
+  //! Number of threads working on a generation.
+  int numThreads() const
+  {
+    return pool ? pool->size() : 1;
+  }
+
+  /**
+   * Calls f(t, threads) once for every thread t of the pool.
+   */
+  template<typename F>
+  void forThreads(const F& f)
+  {
+    const int threads = numThreads();
+    if(threads == 1)
     {
-      T sum = 0.0;
-      for(int j = 0; j < params.N; ++j)
-        sum += B[i][j]*tempRandom[j];
-      x[i] = xmean[i] + eps*sigma*sum;
+      f(0, 1);
+      return;
     }
+    pool->parallelFor(0, threads, [&](const int t0, const int t1)
+    {
+      for(int t = t0; t < t1; ++t)
+        f(t, threads);
+    });
   }
 
-public:
+  /**
+   * Calls f(b) once for every block of C. The threads pick up the blocks
+   * round robin, largest first; the blocks are independent, so the results
+   * do not depend on the number of threads.
+   */
+  template<typename F>
+  void forBlocks(const F& f)
+  {
+    forThreads([&](const int t, const int threads)
+    {
+      for(int k = t; k < numBlocks; k += threads)
+        f(blockOrder[k]);
+    });
+  }
 
-  T countevals;
+  //! Work per row of the loops split by forRows().
+  enum RowCost { FLAT, LOWER, UPPER };
 
-  CMAES()
+  /**
+   * Calls f(first, last) on disjoint row ranges covering [0, n), one per
+   * thread, sized so that the threads get about the same work if row i
+   * costs the same (FLAT), i + 1 (LOWER) or n - i (UPPER). Every row is
+   * computed the same way for any split, so the results do not depend on
+   * the number of threads.
+   */
+  template<typename F>
+  void forRows(const int n, const RowCost cost, const F& f)
+  {
+    forThreads([&](const int t, const int threads)
+    {
+      const int first = rowBound(n, cost, t, threads);
+      const int last = rowBound(n, cost, t + 1, threads);
+      if(first < last)
+        f(first, last);
+    });
+  }
+
+  //! First row of thread t in forRows().
+  static int rowBound(const int n, const RowCost cost, const int t,
+      const int threads)
   {
+    if(t <= 0)
+      return 0;
+    if(t >= threads)
+      return n;
+    const double share = double(t) / threads;
+    if(cost == LOWER)
+      return (int) (n*std::sqrt(share));
+    if(cost == UPPER)
+      return n - (int) (n*std::sqrt(1 - share));
+    return (int) ((long) n*t / threads);
   }
 
   /**
-   * Releases the dynamically allocated memory, including that of the return
-   * value of init().
+   * Points all per-instance arrays into the arena. Called once to measure
+   * the layout and once more, after the arena was allocated, to assign it.
    */
-  ~CMAES()
+  void carve()
   {
-    delete[] pc;
-    delete[] ps;
-    delete[] tempRandom;
-    delete[] BDz;
-    delete[] --xmean;
-    delete[] --xold;
-    delete[] --xBestEver;
-    delete[] --output;
-    delete[] rgD;
-    for(int i = 0; i < params.N; ++i)
+    const int N = params->N;
+    const int lambda = params->lambda;
+
+    // one block of N unless blockSizes is set
+    auto blockSize = [&](const int b)
+    {
+      return params->blockSizes.empty() ? N : params->blockSizes[b];
+    };
+
+    // the padded rows of all blocks of C and of B
+    size_t matrixSize = 0;
+    for(int b = 0; b < numBlocks; ++b)
+      matrixSize += (size_t) blockSize(b)*paddedLength<T>(blockSize(b));
+
+    // O(N^2) matrices first, so that they start on the aligned base
+    T* cBlock = arena.take<T>(matrixSize);
+    T* bBlock = arena.take<T>(matrixSize);
+    selectedSteps = arena.take<T>((size_t) params->mu*rowStride);
+    T* populationBlock = arena.take<T>((size_t) lambda*N);
+    C = arena.take<T*>(N);
+    B = arena.take<T*>(N);
+    population = arena.take<T*>(lambda);
+
+    pc = arena.take<T>(N);
+    ps = arena.take<T>(N);
+    tempRandom = arena.take<T>(N + numBlocks);
+    BDz = arena.take<T>(N);
+    sampleBuffer = arena.take<T>(N);
+    sampleScratch = arena.take<T>((size_t) numThreads()*rowStride);
+    probeBuffer = arena.take<T>(2*N);
+    xmean = arena.take<T>(N);
+    xold = arena.take<T>(N);
+    xBestEver = arena.take<T>(N+2);
+    output = arena.take<T>(N);
+    rgD = arena.take<T>(N);
+    publicFitness = arena.take<T>(lambda);
+    functionValues = arena.take<T>(lambda);
+    funcValueHistory = arena.take<T>(historySize);
+    index = arena.take<int>(lambda);
+    blockStart = arena.take<int>(numBlocks + 1);
+    rowBlock = arena.take<int>(N);
+    blockOrder = arena.take<int>(numBlocks);
+    blockStatus = arena.take<int>(numBlocks);
+
+    if(!arena.allocated())
+      return;
+
+    blockStart[0] = 0;
+    for(int b = 0; b < numBlocks; ++b)
+    {
+      blockStart[b + 1] = blockStart[b] + blockSize(b);
+      blockOrder[b] = b;
+    }
+    std::stable_sort(blockOrder, blockOrder + numBlocks,
+        [&](const int a, const int b)
+    {
+      return blockStart[a + 1] - blockStart[a] >
+          blockStart[b + 1] - blockStart[b];
+    });
+
+    size_t offset = 0;
+    for(int b = 0; b < numBlocks; ++b)
     {
-      delete[] C[i];
-      delete[] B[i];
+      const int stride = paddedLength<T>(blockSize(b));
+      for(int i = blockStart[b]; i < blockStart[b + 1]; ++i)
+      {
+        rowBlock[i] = b;
+        C[i] = cBlock + offset;
+        B[i] = bBlock + offset;
+        offset += stride;
+      }
     }
-    for(int i = 0; i < params.lambda; ++i)
-      delete[] --population[i];
-    delete[] population;
-    delete[] C;
-    delete[] B;
-    delete[] index;
-    delete[] publicFitness;
-    delete[] --functionValues;
-    delete[] --funcValueHistory;
+    for(int i = 0; i < lambda; ++i)
+      population[i] = populationBlock + (size_t) i*N;
+  }
+
+public:
+
+  T countevals;
+
+  CMAES()
+  {
   }
 
   /**
-   * Initializes the CMA-ES algorithm.
+   * Initializes the CMA-ES algorithm with a private copy of the parameters.
    * @param parameters The CMA-ES parameters.
    * @return Array of size lambda that can be used to assign fitness values and
    *         pass them to updateDistribution(). Not that after the desctructor
@@ -588,18 +802,63 @@ public:
    */
   T* init(const Parameters<T>& parameters)
   {
+    return init(std::make_shared<const Parameters<T> >(parameters));
+  }
+
+  /**
+   * Initializes the CMA-ES algorithm, taking over the arrays of the given
+   * parameters instead of copying them.
+   */
+  T* init(Parameters<T>&& parameters)
+  {
+    return init(shareParameters(std::move(parameters)));
+  }
+
+  /**
+   * Initializes the CMA-ES algorithm with a parameter block that may be
+   * shared by many instances, e.g. restarts or sweeps over the same problem.
+   * Nothing is copied; the block must not be modified afterwards.
+   */
+  T* init(const SharedParameters<T>& parameters)
+  {
+    assert(parameters && "init(): parameters must be non-NULL");
     params = parameters;
 
-    stopMessage = "";
+    numBlocks = 1;
+    eigenModulo = params->updateCmode.modulo;
+    if(!params->blockSizes.empty())
+    {
+      int sum = 0;
+      for(size_t b = 0; b < params->blockSizes.size(); ++b)
+      {
+        if(params->blockSizes[b] < 1)
+          throw std::invalid_argument("init(): empty covariance block");
+        sum += params->blockSizes[b];
+      }
+      if(sum != params->N)
+        throw std::invalid_argument("init(): the covariance blocks do not "
+            "sum up to N");
+      numBlocks = (int) params->blockSizes.size();
+
+      if(numBlocks > 1)
+        eigenModulo *= (*std::min_element(params->blockSizes.begin(),
+            params->blockSizes.end()) + T(2)) / (params->N + T(1.5));
+    }
+
+    stopMessage.clear();
+    stopMessage.reserve(4096);
+    stats.reset();
 
     T trace(0);
-    for(int i = 0; i < params.N; ++i)
-      trace += params.rgInitialStds[i]*params.rgInitialStds[i];
-    sigma = std::sqrt(trace/params.N);
+    for(int i = 0; i < params->N; ++i)
+      trace += params->rgInitialStds[i]*params->rgInitialStds[i];
+    sigma = std::sqrt(trace/params->N);
 
-    chiN = std::sqrt((T) params.N) * (T(1) - T(1)/(T(4)*params.N) + T(1)/(T(21)*params.N*params.N));
+    chiN = std::sqrt((T) params->N) * (T(1) - T(1)/(T(4)*params->N) + T(1)/(T(21)*params->N*params->N));
     eigensysIsUptodate = true;
     doCheckEigen = false;
+    eigenDecompositions = 0;
+    eigenFailures = 0;
     genOfEigensysUpdate = 0;
 
     T dtest;
@@ -613,55 +872,40 @@ public:
     state = INITIALIZED;
     dLastMinEWgroesserNull = T(1);
 
-    pc = new T[params.N];
-    ps = new T[params.N];
-    tempRandom = new T[params.N+1];
-    BDz = new T[params.N];
-    xmean = new T[params.N+2];
-    xmean[0] = params.N;
-    ++xmean;
-    xold = new T[params.N+2];
-    xold[0] = params.N;
-    ++xold;
-    xBestEver = new T[params.N+3];
-    xBestEver[0] = params.N;
-    ++xBestEver;
-    xBestEver[params.N] = std::numeric_limits<T>::max();
-    output = new T[params.N+2];
-    output[0] = params.N;
-    ++output;
-    rgD = new T[params.N];
-    C = new T*[params.N];
-    B = new T*[params.N];
-    publicFitness = new T[params.lambda];
-    functionValues = new T[params.lambda+1];
-    functionValues[0] = params.lambda;
-    ++functionValues;
-    const int historySize = 10 + (int) ceil(3.*10.*params.N/params.lambda);
-    funcValueHistory = new T[historySize + 1];
-    funcValueHistory[0] = (T) historySize;
-    funcValueHistory++;
-
-    for(int i = 0; i < params.N; ++i)
+    seed = params->seed;
+    if(seed < 1)
     {
-      C[i] = new T[i+1];
-      B[i] = new T[params.N];
+      long int t = 100*time(0) + clock();
+      seed = (unsigned long) (t < 0 ? -t : t);
     }
-    index = new int[params.lambda];
-    for(int i = 0; i < params.lambda; ++i)
-        index[i] = i;
-    population = new T*[params.lambda];
-    for(int i = 0; i < params.lambda; ++i)
+    rand.start(seed);
+    extraDraws = 0;
+
+    if(params->numThreads > 1)
     {
-      population[i] = new T[params.N+2];
-      population[i][0] = params.N;
-      population[i]++;
-      for(int j = 0; j < params.N; j++)
-        population[i][j] = 0.0;
+      if(!pool || pool->size() != params->numThreads)
+        pool.reset(new ThreadPool(params->numThreads));
     }
+    else
+      pool.reset();
+
+    rowStride = paddedLength<T>(params->N);
+    historySize = 10 + (int) ceil(3.*10.*params->N/params->lambda);
+
+    // measure, allocate and hand out all state in one block
+    arena.reset();
+    carve();
+    arena.allocate(params->hugePages);
+    carve();
+
+    xBestEver[params->N] = std::numeric_limits<T>::max();
+    for(int i = 0; i < params->lambda; ++i)
+        index[i] = i;
+    std::fill(population[0], population[0] + (size_t) params->lambda*params->N,
+        T(0));
 
     // initialize newed space
-    for(int i = 0; i < params.lambda; i++)
+    for(int i = 0; i < params->lambda; i++)
     {
       functionValues[i] = std::numeric_limits<T>::max();
     }
@@ -669,47 +913,58 @@ public:
     {
       funcValueHistory[i] = std::numeric_limits<T>::max();
     }
-    for(int i = 0; i < params.N; ++i)
-      for(int j = 0; j < i; ++j)
-        C[i][j] = B[i][j] = B[j][i] = 0.;
+    for(int b = 0; b < numBlocks; ++b)
+    {
+      const int o = blockStart[b];
+      const int n = blockStart[b + 1] - o;
+      std::fill(C[o], C[o] + (size_t) n*paddedLength<T>(n), T(0));
+      std::fill(B[o], B[o] + (size_t) n*paddedLength<T>(n), T(0));
+    }
 
-    for(int i = 0; i < params.N; ++i)
+    for(int i = 0; i < params->N; ++i)
     {
-      B[i][i] = T(1);
-      C[i][i] = rgD[i] = params.rgInitialStds[i]*std::sqrt(params.N/trace);
-      C[i][i] *= C[i][i];
+      B[i][i - blockStart[rowBlock[i]]] = T(1);
+      diagC(i) = rgD[i] = params->rgInitialStds[i]*std::sqrt(params->N/trace);
+      diagC(i) *= diagC(i);
       pc[i] = ps[i] = T(0);
     }
-    minEW = minElement(rgD, params.N);
+    minEW = minElement(rgD, params->N);
     minEW = minEW*minEW;
-    maxEW = maxElement(rgD, params.N);
+    maxEW = maxElement(rgD, params->N);
     maxEW = maxEW*maxEW;
 
-    maxdiagC = C[0][0];
-    for(int i = 1; i < params.N; ++i) if(maxdiagC < C[i][i]) maxdiagC = C[i][i];
-    mindiagC = C[0][0];
-    for(int i = 1; i < params.N; ++i) if(mindiagC > C[i][i]) mindiagC = C[i][i];
+    maxdiagC = diagC(0);
+    for(int i = 1; i < params->N; ++i) if(maxdiagC < diagC(i)) maxdiagC = diagC(i);
+    mindiagC = diagC(0);
+    for(int i = 1; i < params->N; ++i) if(mindiagC > diagC(i)) mindiagC = diagC(i);
 
-    for(int i = 0; i < params.N; ++i)
-      xmean[i] = xold[i] = params.xstart[i];
-    // use in case xstart as typicalX
-    if(params.typicalXcase)
-      for(int i = 0; i < params.N; ++i)
-        xmean[i] += sigma*rgD[i]*rand.gauss();
+    for(int i = 0; i < params->N; ++i)
+      xmean[i] = xold[i] = params->xstart[i];
+    // use in case xstart as typicalX, drawn from stream (0, 0)
+    if(params->typicalXcase)
+    {
+      rand.gauss(0, 0, tempRandom, params->N);
+      for(int i = 0; i < params->N; ++i)
+        xmean[i] += sigma*rgD[i]*tempRandom[i];
+    }
 
     return publicFitness;
   }
 
 
   /**
-   * The search space vectors have a special form: they are arrays with N+1
-   * entries. Entry number -1 is the dimension of the search space N.
+   * The search space vectors are stored back to back, population[i] is
+   * population[0] + i*N. Offspring i of generation g only depends on the
+   * seed, g, i and the distribution, so instances with the same seed and
+   * fitness values sample identical populations, independent of the number
+   * of threads or hosts; sampling the same generation again gives the same
+   * population.
    * @return A pointer to a "population" of lambda N-dimensional multivariate
    * normally distributed samples.
    */
   T* const* samplePopulation()
   {
-    bool diag = params.diagonalCov == 1 || params.diagonalCov >= gen;
+    bool diag = params->diagonalCov == 1 || params->diagonalCov >= gen;
 
     // calculate eigensystem
     if(!eigensysIsUptodate)
@@ -718,10 +973,10 @@ public:
         updateEigensystem(false);
       else
       {
-        for(int i = 0; i < params.N; ++i)
-          rgD[i] = std::sqrt(C[i][i]);
-        minEW = square(minElement(rgD, params.N));
-        maxEW = square(maxElement(rgD, params.N));
+        for(int i = 0; i < params->N; ++i)
+          rgD[i] = std::sqrt(diagC(i));
+        minEW = square(minElement(rgD, params->N));
+        maxEW = square(maxElement(rgD, params->N));
         eigensysIsUptodate = true;
 
       }
@@ -729,26 +984,34 @@ public:
 
     testMinStdDevs();
 
-    for(int iNk = 0; iNk < params.lambda; ++iNk)
-    { // generate scaled random vector D*z
-      T* rgrgxink = population[iNk];
-      for(int i = 0; i < params.N; ++i)
-        if(diag)
-          rgrgxink[i] = xmean[i] + sigma*rgD[i]*rand.gauss();
-        else
-          tempRandom[i] = rgD[i]*rand.gauss();
-      if(!diag)
-        for(int i = 0; i < params.N; ++i) // add mutation sigma*B*(D*z)
-        {
-          T sum = 0.0;
-          for(int j = 0; j < params.N; ++j)
-            sum += B[i][j]*tempRandom[j];
-          rgrgxink[i] = xmean[i] + sigma*sum;
-        }
-    }
+    NEURO_CMAES_TIME(sample);
+    // offspring iNk of generation g is drawn from stream (g, iNk)
+    const T sampledGen = (state == UPDATED || gen == 0) ? gen + 1 : gen;
+    forThreads([&](const int t, const int threads)
+    {
+      T* dz = sampleScratch + (size_t) t*rowStride;
+      int first, last;
+      ThreadPool::chunk(0, params->lambda, threads, t, first, last);
+      for(int iNk = first; iNk < last; ++iNk)
+      { // generate scaled random vector D*z
+        T* rgrgxink = population[iNk];
+        rand.gauss((uint64_t) sampledGen, iNk, dz, params->N);
+        for(int i = 0; i < params->N; ++i)
+          if(diag)
+            rgrgxink[i] = xmean[i] + sigma*rgD[i]*dz[i];
+          else
+            dz[i] *= rgD[i];
+        if(!diag)
+          for(int i = 0; i < params->N; ++i) // add mutation sigma*B*(D*z)
+            rgrgxink[i] = xmean[i] + sigma*rowTimesB(i, dz);
+      }
+    });
 
     if(state == UPDATED || gen == 0)
+    {
       ++gen;
+      extraDraws = 0;
+    }
     state = SAMPLED;
 
     return population;
@@ -764,7 +1027,7 @@ public:
   T* const* reSampleSingle(int i)
   {
     T* x;
-    assert(i >= 0 && i < params.lambda &&
+    assert(i >= 0 && i < params->lambda &&
         "reSampleSingle(): index must be between 0 and sp.lambda");
     x = population[i];
     addMutation(x);
@@ -779,16 +1042,16 @@ public:
    * Input x can be a pointer to an element of the vector returned by
    * samplePopulation() but this is inconsistent with the const qualifier of the
    * returned value and therefore rather reSampleSingle() should be used.
-   * @param x Solution vector that gets sampled a new value. If x == NULL new
-   *          memory is allocated and must be released by the user using
-   *          delete[].
+   * @param x Solution vector that gets sampled a new value. If x == NULL an
+   *          internal buffer is used, which is overwritten by the next call
+   *          and must not be released by the user.
    * @return A pointer to the resampled solution vector, equals input x for
    *         x != NULL on input.
    */
   T* sampleSingleInto(T* x)
   {
     if(!x)
-      x = new T[params.N];
+      x = sampleBuffer;
     addMutation(x);
     return x;
   }
@@ -811,11 +1074,10 @@ public:
 
   /**
    * Used to reevaluate a slightly disturbed solution for an uncertaintly
-   * measurement. In case if x == NULL on input, the memory of the returned x
-   * must be released.
-   * @param x Solution vector that gets sampled a new value. If x == NULL new
-   *          memory is allocated and must be released by the user using
-   *          delete[] x.
+   * measurement.
+   * @param x Solution vector that gets sampled a new value. If x == NULL an
+   *          internal buffer is used, which is overwritten by the next call
+   *          and must not be released by the user.
    * @param pxmean Mean vector for perturbation.
    * @param eps Scale factor for perturbation:
    * @return A pointer to the perturbed solution vector, equals input x for
@@ -824,7 +1086,7 @@ public:
   T* perturbSolutionInto(T* x, T const* pxmean, T eps)
   {
     if(!x)
-      x = new T[params.N];
+      x = sampleBuffer;
     assert(pxmean && "perturbSolutionInto(): pxmean was not given");
     addMutation(x, eps);
     return x;
@@ -839,114 +1101,133 @@ public:
    */
   T* updateDistribution(const T* fitnessValues)
   {
-    const int N = params.N;
-    bool diag = params.diagonalCov == 1 || params.diagonalCov >= gen;
+    const int N = params->N;
+    bool diag = params->diagonalCov == 1 || params->diagonalCov >= gen;
 
     assert(state != UPDATED && "updateDistribution(): You need to call "
           "samplePopulation() before update can take place.");
     assert(fitnessValues && "updateDistribution(): No fitness function value array input.");
 
     if(state == SAMPLED) // function values are delivered here
-      countevals += params.lambda;
-    else if(params.logWarnings)
-      params.logStream <<  "updateDistribution(): unexpected state" << std::endl;
+      countevals += params->lambda;
+    else if(params->logWarnings)
+      params->logStream <<  "updateDistribution(): unexpected state" << std::endl;
 
     // assign function values
-    for(int i = 0; i < params.lambda; ++i)
-      population[i][N] = functionValues[i] = fitnessValues[i];
+    for(int i = 0; i < params->lambda; ++i)
+      functionValues[i] = fitnessValues[i];
 
     // Generate index
-    sortIndex(fitnessValues, index, params.lambda);
+    {
+      NEURO_CMAES_TIME(sort);
+      sortIndex(fitnessValues, index, params->lambda);
+    }
 
     // Test if function values are identical, escape flat fitness
-    if(fitnessValues[index[0]] == fitnessValues[index[(int) params.lambda / 2]])
+    if(fitnessValues[index[0]] == fitnessValues[index[(int) params->lambda / 2]])
     {
-      sigma *= std::exp(T(0.2) + params.cs / params.damps);
-      if(params.logWarnings)
+      sigma *= std::exp(T(0.2) + params->cs / params->damps);
+      if(params->logWarnings)
       {
-        params.logStream << "Warning: sigma increased due to equal function values"
+        params->logStream << "Warning: sigma increased due to equal function values"
             << std::endl << "   Reconsider the formulation of the objective function";
       }
     }
 
     // update function value history
-    for(int i = (int) *(funcValueHistory - 1) - 1; i > 0; --i)
+    for(int i = historySize - 1; i > 0; --i)
       funcValueHistory[i] = funcValueHistory[i - 1];
     funcValueHistory[0] = fitnessValues[index[0]];
 
     // update xbestever
-    if(xBestEver[N] > population[index[0]][N] || gen == 1)
-      for(int i = 0; i <= N; ++i)
-      {
-        xBestEver[i] = population[index[0]][i];
-        xBestEver[N+1] = countevals;
-      }
-
-    const T sqrtmueffdivsigma = std::sqrt(params.mueff) / sigma;
-    // calculate xmean and rgBDz~N(0,C)
-    for(int i = 0; i < N; ++i)
+    if(xBestEver[N] > functionValues[index[0]] || gen == 1)
     {
-      xold[i] = xmean[i];
-      xmean[i] = 0.;
-      for(int iNk = 0; iNk < params.mu; ++iNk)
-        xmean[i] += params.weights[iNk]*population[index[iNk]][i];
-      BDz[i] = sqrtmueffdivsigma*(xmean[i]-xold[i]);
+      for(int i = 0; i < N; ++i)
+        xBestEver[i] = population[index[0]][i];
+      xBestEver[N] = functionValues[index[0]];
+      xBestEver[N+1] = countevals;
     }
 
-    // calculate z := D^(-1)* B^(-1)* rgBDz into rgdTmp
-    for(int i = 0; i < N; ++i)
+    // update of the mean and the evolution paths
+    T psxps;
+    int hsig;
     {
-      T sum;
-      if(diag)
-        sum = BDz[i];
-      else
+      NEURO_CMAES_TIME(mean);
+      const T sqrtmueffdivsigma = std::sqrt(params->mueff) / sigma;
+      // calculate xmean and rgBDz~N(0,C)
+      forRows(N, FLAT, [&](const int i0, const int i1)
       {
-        sum = 0.;
-        for(int j = 0; j < N; ++j)
-          sum += B[j][i]*BDz[j];
-      }
-      tempRandom[i] = sum/rgD[i];
-    }
+        for(int i = i0; i < i1; ++i)
+        {
+          xold[i] = xmean[i];
+          xmean[i] = 0.;
+          for(int iNk = 0; iNk < params->mu; ++iNk)
+            xmean[i] += params->weights[iNk]*population[index[iNk]][i];
+          BDz[i] = sqrtmueffdivsigma*(xmean[i]-xold[i]);
+        }
+      });
 
-    // cumulation for sigma (ps) using B*z
-    const T sqrtFactor = std::sqrt(params.cs*(T(2)-params.cs));
-    const T invps = T(1)-params.cs;
-    for(int i = 0; i < N; ++i)
-    {
-      T sum;
-      if(diag)
-        sum = tempRandom[i];
-      else
+      // calculate z := D^(-1)* B^(-1)* rgBDz into rgdTmp, running over the
+      // rows of B for every slice of z
+      forRows(N, FLAT, [&](const int i0, const int i1)
       {
-        sum = T(0);
-        T* Bi = B[i];
-        for(int j = 0; j < N; ++j)
-          sum += Bi[j]*tempRandom[j];
+        if(diag)
+          std::copy(BDz + i0, BDz + i1, tempRandom + i0);
+        else
+        {
+          // B is block diagonal, row j only reaches the slice where it
+          // overlaps the block of j
+          std::fill(tempRandom + i0, tempRandom + i1, T(0));
+          for(int j = 0; j < N; ++j)
+          {
+            const int b = rowBlock[j];
+            const int o = blockStart[b];
+            const int first = std::max(i0, o);
+            const int last = std::min(i1, blockStart[b + 1]);
+            const T* Bj = B[j];
+            const T BDzj = BDz[j];
+            for(int i = first; i < last; ++i)
+              tempRandom[i] += Bj[i - o]*BDzj;
+          }
+        }
+        for(int i = i0; i < i1; ++i)
+          tempRandom[i] /= rgD[i];
+      });
+
+      // cumulation for sigma (ps) using B*z
+      const T sqrtFactor = std::sqrt(params->cs*(T(2)-params->cs));
+      const T invps = T(1)-params->cs;
+      forRows(N, FLAT, [&](const int i0, const int i1)
+      {
+        for(int i = i0; i < i1; ++i)
+        {
+          const T sum = diag ? tempRandom[i] : rowTimesB(i, tempRandom);
+          ps[i] = invps*ps[i] + sqrtFactor*sum;
+        }
+      });
+
+      // calculate norm(ps)^2
+      psxps = T(0);
+      for(int i = 0; i < N; ++i)
+      {
+        const T& rgpsi = ps[i];
+        psxps += rgpsi*rgpsi;
       }
-      ps[i] = invps*ps[i] + sqrtFactor*sum;
-    }
 
-    // calculate norm(ps)^2
-    T psxps(0);
-    for(int i = 0; i < N; ++i)
-    {
-      const T& rgpsi = ps[i];
-      psxps += rgpsi*rgpsi;
+      // cumulation for covariance matrix (pc) using B*D*z~N(0,C)
+      hsig = std::sqrt(psxps) / std::sqrt(T(1) - std::pow(T(1) - params->cs, T(2)* gen))
+          / chiN < T(1.4) + T(2) / (N + 1);
+      const T ccumcovinv = 1.-params->ccumcov;
+      const T hsigFactor = hsig*std::sqrt(params->ccumcov*(T(2)-params->ccumcov));
+      for(int i = 0; i < N; ++i)
+        pc[i] = ccumcovinv*pc[i] + hsigFactor*BDz[i];
     }
 
-    // cumulation for covariance matrix (pc) using B*D*z~N(0,C)
-    int hsig = std::sqrt(psxps) / std::sqrt(T(1) - std::pow(T(1) - params.cs, T(2)* gen))
-        / chiN < T(1.4) + T(2) / (N + 1);
-    const T ccumcovinv = 1.-params.ccumcov;
-    const T hsigFactor = hsig*std::sqrt(params.ccumcov*(T(2)-params.ccumcov));
-    for(int i = 0; i < N; ++i)
-      pc[i] = ccumcovinv*pc[i] + hsigFactor*BDz[i];
-
     // update of C
     adaptC2(hsig);
 
     // update of sigma
-    sigma *= std::exp(((std::sqrt(psxps) / chiN) - T(1))* params.cs / params.damps);
+    sigma *= std::exp(((std::sqrt(psxps) / chiN) - T(1))* params->cs / params->damps);
 
     state = UPDATED;
     return xmean;
@@ -955,67 +1236,66 @@ public:
 
   bool testForTermination()
   {
+    NEURO_CMAES_TIME(termination);
     T range, fac;
     int iAchse, iKoo;
-    int diag = params.diagonalCov == 1 || params.diagonalCov >= gen;
-    int N = params.N;
-    std::stringstream message;
+    int diag = params->diagonalCov == 1 || params->diagonalCov >= gen;
+    int N = params->N;
 
-    if(stopMessage != "")
-    {
-      message << stopMessage << std::endl;
-    }
+    if(!stopMessage.empty())
+      stopMessage += '\n';
 
     // function value reached
-    if((gen > 1 || state > SAMPLED) && params.stStopFitness.flg &&
-        functionValues[index[0]] <= params.stStopFitness.val)
+    if((gen > 1 || state > SAMPLED) && params->stStopFitness.flg &&
+        functionValues[index[0]] <= params->stStopFitness.val)
     {
-      message << "Fitness: function value " << functionValues[index[0]]
-          << " <= stopFitness (" << params.stStopFitness.val << ")" << std::endl;
+      appendStopMessage("Fitness: function value %g <= stopFitness (%g)",
+          (double) functionValues[index[0]], (double) params->stStopFitness.val);
     }
 
     // TolFun
-    range = std::max(maxElement(funcValueHistory, (int) std::min(gen, *(funcValueHistory - 1))),
-        maxElement(functionValues, params.lambda)) -
-        std::min(minElement(funcValueHistory, (int) std::min(gen, *(funcValueHistory - 1))),
-        minElement(functionValues, params.lambda));
+    range = std::max(maxElement(funcValueHistory, (int) std::min(gen, (T) historySize)),
+        maxElement(functionValues, params->lambda)) -
+        std::min(minElement(funcValueHistory, (int) std::min(gen, (T) historySize)),
+        minElement(functionValues, params->lambda));
 
-    if(gen > 0 && range <= params.stopTolFun)
+    if(gen > 0 && range <= params->stopTolFun)
     {
-      message << "TolFun: function value differences " << range
-          << " < stopTolFun=" << params.stopTolFun << std::endl;
+      appendStopMessage("TolFun: function value differences %g < stopTolFun=%g",
+          (double) range, (double) params->stopTolFun);
     }
 
     // TolFunHist
-    if(gen > *(funcValueHistory - 1))
+    if(gen > historySize)
     {
-      range = maxElement(funcValueHistory, (int) *(funcValueHistory - 1))
-          - minElement(funcValueHistory, (int) *(funcValueHistory - 1));
-      if(range <= params.stopTolFunHist)
-        message << "TolFunHist: history of function value changes " << range
-            << " stopTolFunHist=" << params.stopTolFunHist << std::endl;
+      range = maxElement(funcValueHistory, historySize)
+          - minElement(funcValueHistory, historySize);
+      if(range <= params->stopTolFunHist)
+        appendStopMessage("TolFunHist: history of function value changes %g"
+            " stopTolFunHist=%g", (double) range, (double) params->stopTolFunHist);
     }
 
     // TolX
     int cTemp = 0;
     for(int i = 0; i < N; ++i)
     {
-      cTemp += (sigma*std::sqrt(C[i][i]) < params.stopTolX) ? 1 : 0;
-      cTemp += (sigma*pc[i] < params.stopTolX) ? 1 : 0;
+      cTemp += (sigma*std::sqrt(diagC(i)) < params->stopTolX) ? 1 : 0;
+      cTemp += (sigma*pc[i] < params->stopTolX) ? 1 : 0;
     }
     if(cTemp == 2*N)
     {
-      message << "TolX: object variable changes below " << params.stopTolX << std::endl;
+      appendStopMessage("TolX: object variable changes below %g",
+          (double) params->stopTolX);
     }
 
     // TolUpX
     for(int i = 0; i < N; ++i)
     {
-      if(sigma*std::sqrt(C[i][i]) > params.stopTolUpXFactor*params.rgInitialStds[i])
+      if(sigma*std::sqrt(diagC(i)) > params->stopTolUpXFactor*params->rgInitialStds[i])
       {
-        message << "TolUpX: standard deviation increased by more than "
-            << params.stopTolUpXFactor << ", larger initial standard deviation recommended."
-            << std::endl;
+        appendStopMessage("TolUpX: standard deviation increased by more than %g"
+            ", larger initial standard deviation recommended.",
+            (double) params->stopTolUpXFactor);
         break;
       }
     }
@@ -1023,26 +1303,29 @@ public:
     // Condition of C greater than dMaxSignifKond
     if(maxEW >= minEW* dMaxSignifKond)
     {
-      message << "ConditionNumber: maximal condition number " << dMaxSignifKond
-          << " reached. maxEW=" << maxEW <<  ",minEW=" << minEW << ",maxdiagC="
-          << maxdiagC << ",mindiagC=" << mindiagC << std::endl;
+      appendStopMessage("ConditionNumber: maximal condition number %g reached."
+          " maxEW=%g,minEW=%g,maxdiagC=%g,mindiagC=%g", (double) dMaxSignifKond,
+          (double) maxEW, (double) minEW, (double) maxdiagC, (double) mindiagC);
     }
 
     // Principal axis i has no effect on xmean, ie. x == x + 0.1* sigma* rgD[i]* B[i]
+    // B is block diagonal, so the axis only reaches the coordinates of its block
     if(!diag)
     {
       for(iAchse = 0; iAchse < N; ++iAchse)
       {
+        const int o = blockStart[rowBlock[iAchse]];
+        const int end = blockStart[rowBlock[iAchse] + 1];
         fac = 0.1* sigma* rgD[iAchse];
-        for(iKoo = 0; iKoo < N; ++iKoo)
+        for(iKoo = o; iKoo < end; ++iKoo)
         {
-          if(xmean[iKoo] != xmean[iKoo] + fac* B[iKoo][iAchse])
+          if(xmean[iKoo] != xmean[iKoo] + fac* B[iKoo][iAchse - o])
             break;
         }
-        if(iKoo == N)
+        if(iKoo == end)
         {
-          message << "NoEffectAxis: standard deviation 0.1*" << (fac / 0.1)
-              << " in principal axis " << iAchse << " without effect" << std::endl;
+          appendStopMessage("NoEffectAxis: standard deviation 0.1*%g in principal"
+              " axis %d without effect", (double) (fac / 0.1), iAchse);
           break;
         }
       }
@@ -1050,28 +1333,27 @@ public:
     // Component of xmean is not changed anymore
     for(iKoo = 0; iKoo < N; ++iKoo)
     {
-      if(xmean[iKoo] == xmean[iKoo] + sigma*std::sqrt(C[iKoo][iKoo])/T(5))
+      if(xmean[iKoo] == xmean[iKoo] + sigma*std::sqrt(diagC(iKoo))/T(5))
       {
-        message << "NoEffectCoordinate: standard deviation 0.2*"
-            << (sigma*std::sqrt(C[iKoo][iKoo])) << " in coordinate " << iKoo
-            << " without effect" << std::endl;
+        appendStopMessage("NoEffectCoordinate: standard deviation 0.2*%g in"
+            " coordinate %d without effect",
+            (double) (sigma*std::sqrt(diagC(iKoo))), iKoo);
         break;
       }
     }
 
-    if(countevals >= params.stopMaxFunEvals)
+    if(countevals >= params->stopMaxFunEvals)
     {
-      message << "MaxFunEvals: conducted function evaluations " << countevals
-          << " >= " << params.stopMaxFunEvals << std::endl;
+      appendStopMessage("MaxFunEvals: conducted function evaluations %g >= %g",
+          (double) countevals, (double) params->stopMaxFunEvals);
     }
-    if(gen >= params.stopMaxIter)
+    if(gen >= params->stopMaxIter)
     {
-      message << "MaxIter: number of iterations " << gen << " >= "
-          << params.stopMaxIter << std::endl;
+      appendStopMessage("MaxIter: number of iterations %g >= %g", (double) gen,
+          (double) params->stopMaxIter);
     }
 
-    stopMessage = message.str();
-    return stopMessage != "";
+    return !stopMessage.empty();
   }
 
   /**
@@ -1083,6 +1365,22 @@ public:
     return stopMessage;
   }
 
+  /**
+   * Cumulative and last-call timings of the phases since init() or
+   * resetStats(). Only recorded if NEURO_CMAES_STATS is defined, see
+   * CMAESStats::enabled().
+   */
+  const CMAESStats& statistics() const
+  {
+    return stats;
+  }
+
+  //! Sets all phase timings to zero.
+  void resetStats()
+  {
+    stats.reset();
+  }
+
   void updateEigensystem(bool force)
   {
 
@@ -1091,21 +1389,39 @@ public:
       if(eigensysIsUptodate)
         return;
       // return on modulo generation number
-      if(gen < genOfEigensysUpdate + params.updateCmode.modulo)
+      if(gen < genOfEigensysUpdate + eigenModulo)
         return;
 
     }
 
-    eigen(rgD, B, tempRandom);
+    NEURO_CMAES_TIME(eigen);
+    const bool check = params->eigenCheckInterval > 0 &&
+        ++eigenDecompositions % params->eigenCheckInterval == 0;
+    forBlocks([&](const int b)
+    {
+      blockStatus[b] = decomposeBlock(b, check);
+    });
+
+    for(int b = 0; b < numBlocks; ++b)
+    {
+      if(blockStatus[b] == 0)
+        continue;
+      ++eigenFailures;
+      if(params->logWarnings)
+        params->logStream << "updateEigensystem(): randomized check of block "
+            << b << " failed, " << (blockStatus[b] == 1 ? "decomposed C "
+            "with a shifted diagonal" : "using the diagonal of C") << std::endl;
+    }
 
     // find largest and smallest eigenvalue, they are supposed to be sorted anyway
-    minEW = minElement(rgD, params.N);
-    maxEW = maxElement(rgD, params.N);
+    minEW = minElement(rgD, params->N);
+    maxEW = maxElement(rgD, params->N);
 
     if(doCheckEigen) // needs O(n^3)! writes, in case, error message in error file
-      checkEigen(rgD, B);
+      for(int b = 0; b < numBlocks; ++b)
+        checkEigen(b);
 
-    for(int i = 0; i < params.N; ++i)
+    for(int i = 0; i < params->N; ++i)
       rgD[i] = std::sqrt(rgD[i]);
 
     eigensysIsUptodate = true;
@@ -1124,13 +1440,62 @@ public:
         "of samplePopulation and updateDistribution");
 
     if(newxmean && newxmean != xmean)
-      for(int i = 0; i < params.N; ++i)
+      for(int i = 0; i < params->N; ++i)
         xmean[i] = newxmean[i];
     else
       newxmean = xmean;
 
     return newxmean;
   }
+
+  /**
+   * Minimizes the given function, starting from the given iterate, in the
+   * style of the mlpack optimizers. The parameters of the last init() are
+   * used with the iterate as start point; without a prior init() the
+   * defaults of Parameters are used. The function must provide
+   *
+   *   void Evaluate(const arma::Mat<T>& candidates, arma::Row<T>& fitness);
+   *
+   * which sets the fitness of every column of candidates. Both arguments
+   * are views over the memory of the engine and must not be resized.
+   * @param function The function to minimize.
+   * @param iterate The start point; receives the best point found.
+   * @return The fitness of the best point found.
+   */
+  template<typename FunctionType>
+  T Optimize(FunctionType& function, arma::Mat<T>& iterate)
+  {
+    const int n = (int) iterate.n_elem;
+    if(params && params->N == n)
+    {
+      Parameters<T> parameters(*params);
+      std::copy(iterate.memptr(), iterate.memptr() + n, parameters.xstart);
+      parameters.typicalXcase = false;
+      init(std::move(parameters));
+    }
+    else if(!params)
+    {
+      Parameters<T> parameters;
+      parameters.init(n, iterate.memptr());
+      init(std::move(parameters));
+    }
+    else
+      throw std::invalid_argument("Optimize(): the iterate has " +
+          std::to_string(n) + " elements, the parameters are for " +
+          std::to_string(params->N) + ".");
+
+    arma::Row<T> fitness = fitnessVector();
+    while(!testForTermination())
+    {
+      samplePopulation();
+      const arma::Mat<T> candidates = populationMatrix();
+      function.Evaluate(candidates, fitness);
+      updateDistribution(publicFitness);
+    }
+
+    std::copy(xBestEver, xBestEver + n, iterate.memptr());
+    return xBestEver[n];
+  }
 };
 
 
@@ -8,6 +8,8 @@
 #include <mlpack/methods/ann/activation_functions/rectifier_function.hpp>
 #include <mlpack/methods/ann/activation_functions/tanh_function.hpp>
 
+#include "utils.hpp"
+
 namespace mlpack {
 namespace neuro_cmaes {
 
@@ -120,22 +122,49 @@ class NeuronGene {
 
   // Calculate activation based on current input.
   void CalcActivation() {
-    switch (aActFuncType) { // TODO: more cases.
-      case SIGMOID:                   
-        aActivation = ann::LogisticFunction::fn(aInput);
-        break;
+    aActivation = ActivationFunction(aActFuncType, aInput);
+  }
+
+  // Activation function of the given type applied to input.
+  static double ActivationFunction(ActivationFuncType actFuncType,
+                                   double input) {
+    switch (actFuncType) { // TODO: more cases.
+      case SIGMOID:
+        return ann::LogisticFunction::fn(input);
+      case TANH:
+        return ann::TanhFunction::fn(input);
+      case RELU:
+        return ann::RectifierFunction::fn(input);
+      case LINEAR:
+        return input;
+      default:
+        return ann::LogisticFunction::fn(input);
+    }
+  }
+
+  // Activation function of the given type applied to the n values of input,
+  // written to output, which may be input. Uses fastSigmoid() and fastTanh()
+  // so that the loops vectorize.
+  static void ActivationFunction(ActivationFuncType actFuncType,
+                                 const double* input,
+                                 double* output,
+                                 size_t n) {
+    switch (actFuncType) {
       case TANH:
-        aActivation = ann::TanhFunction::fn(aInput);
+        for (size_t i = 0; i < n; ++i)
+          output[i] = fastTanh(input[i]);
         break;
       case RELU:
-        aActivation = ann::RectifierFunction::fn(aInput);
+        for (size_t i = 0; i < n; ++i)
+          output[i] = std::max(input[i], 0.0);
         break;
       case LINEAR:
-        aActivation = aInput;
+        if (output != input)
+          std::copy(input, input + n, output);
         break;
       default:
-        aActivation = ann::LogisticFunction::fn(aInput);
-        break;
+        for (size_t i = 0; i < n; ++i)
+          output[i] = fastSigmoid(input[i]);
     }
   }
 
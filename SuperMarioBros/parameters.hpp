@@ -3,10 +3,12 @@
 
 #include <cmath>
 #include <limits>
+#include <memory>
 #include <ostream>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 
 namespace mlpack {
@@ -104,6 +106,33 @@ public:
     UNINITIALIZED_WEIGHTS, LINEAR_WEIGHTS, EQUAL_WEIGHTS, LOG_WEIGHTS
   } weightMode;
 
+  //! Back the state of CMAES with transparent huge pages, for large N.
+  bool hugePages;
+
+  //! Threads used by samplePopulation() and updateDistribution(). The work
+  //! is split by rows, so the results do not depend on the number.
+  int numThreads;
+
+  //! Verify every eigenCheckInterval-th eigendecomposition of C with random
+  //! probes in O(eigenCheckProbes*N^2), 0 disables the test.
+  int eigenCheckInterval;
+  //! Number of random probe vectors and of sampled column pairs of B.
+  int eigenCheckProbes;
+  //! Relative residual above which a decomposition is rejected.
+  T eigenCheckTolerance;
+
+  //! Seed of the offspring samples, 0 uses the clock. Instances with the same
+  //! seed and parameters sample identical populations.
+  unsigned long seed;
+
+  /**
+   * Sizes of the diagonal blocks of the covariance matrix, consecutive
+   * coordinates each, summing up to N. Coordinates of different blocks are
+   * sampled and adapted independently, e.g. the incoming weights of every
+   * neuron. Empty for a full covariance matrix.
+   */
+  std::vector<int> blockSizes;
+
   //! Set to true to activate logging warnings.
   bool logWarnings;
   //! Output stream that is used to log warnings, usually std::cerr.
@@ -134,6 +163,12 @@ public:
         ccov(-1),
         facupdateCmode(1),
         weightMode(UNINITIALIZED_WEIGHTS),
+        hugePages(false),
+        numThreads(1),
+        eigenCheckInterval(1),
+        eigenCheckProbes(2),
+        eigenCheckTolerance(1e-8),
+        seed(0),
         logWarnings(false),
         logStream(std::cerr)
   {
@@ -144,10 +179,31 @@ public:
   }
 
   Parameters(const Parameters& parameters)
+      : xstart(0),
+        typicalX(0),
+        rgInitialStds(0),
+        rgDiffMinChange(0),
+        weights(0),
+        logStream(parameters.logStream)
   {
     assign(parameters);
   }
 
+  /**
+   * Takes over the arrays of the given parameters, which is left without
+   * arrays.
+   */
+  Parameters(Parameters&& parameters)
+      : xstart(0),
+        typicalX(0),
+        rgInitialStds(0),
+        rgDiffMinChange(0),
+        weights(0),
+        logStream(parameters.logStream)
+  {
+    take(parameters);
+  }
+
   ~Parameters()
   {
     if(xstart)
@@ -162,9 +218,21 @@ public:
       delete[] weights;
   }
 
+  /**
+   * Copies all values. The log stream is a reference and keeps pointing to
+   * the stream this object was constructed with.
+   */
   Parameters& operator=(const Parameters& parameters)
   {
-    assign(parameters);
+    if(this != &parameters)
+      assign(parameters);
+    return *this;
+  }
+
+  Parameters& operator=(Parameters&& parameters)
+  {
+    if(this != &parameters)
+      take(parameters);
     return *this;
   }
 
@@ -247,10 +315,11 @@ public:
 private:
   void assign(const Parameters& p)
   {
-    N = p.N;
+    assignScalars(p);
 
     if(xstart)
       delete[] xstart;
+    xstart = 0;
     if(p.xstart)
     {
       xstart = new T[N];
@@ -260,6 +329,7 @@ private:
 
     if(typicalX)
       delete[] typicalX;
+    typicalX = 0;
     if(p.typicalX)
     {
       typicalX = new T[N];
@@ -267,10 +337,9 @@ private:
         typicalX[i] = p.typicalX[i];
     }
 
-    typicalXcase = p.typicalXcase;
-
     if(rgInitialStds)
       delete[] rgInitialStds;
+    rgInitialStds = 0;
     if(p.rgInitialStds)
     {
       rgInitialStds = new T[N];
@@ -280,6 +349,7 @@ private:
 
     if(rgDiffMinChange)
       delete[] rgDiffMinChange;
+    rgDiffMinChange = 0;
     if(p.rgDiffMinChange)
     {
       rgDiffMinChange = new T[N];
@@ -287,6 +357,49 @@ private:
         rgDiffMinChange[i] = p.rgDiffMinChange[i];
     }
 
+    if(weights)
+      delete[] weights;
+    weights = 0;
+    if(p.weights)
+    {
+      weights = new T[mu];
+      for(int i = 0; i < mu; i++)
+        weights[i] = p.weights[i];
+    }
+  }
+
+  /**
+   * Frees the arrays of this object and moves the arrays of p into it
+   * without copying them. p is left without arrays.
+   */
+  void take(Parameters& p)
+  {
+    assignScalars(p);
+
+    delete[] xstart;
+    delete[] typicalX;
+    delete[] rgInitialStds;
+    delete[] rgDiffMinChange;
+    delete[] weights;
+
+    xstart = p.xstart;
+    typicalX = p.typicalX;
+    rgInitialStds = p.rgInitialStds;
+    rgDiffMinChange = p.rgDiffMinChange;
+    weights = p.weights;
+
+    p.xstart = 0;
+    p.typicalX = 0;
+    p.rgInitialStds = 0;
+    p.rgDiffMinChange = 0;
+    p.weights = 0;
+  }
+
+  void assignScalars(const Parameters& p)
+  {
+    N = p.N;
+    typicalXcase = p.typicalXcase;
+
     stopMaxFunEvals = p.stopMaxFunEvals;
     facmaxeval = p.facmaxeval;
     stopMaxIter = p.stopMaxIter;
@@ -304,15 +417,6 @@ private:
     mucov = p.mucov;
     mueff = p.mueff;
 
-    if(weights)
-      delete[] weights;
-    if(p.weights)
-    {
-      weights = new T[mu];
-      for(int i = 0; i < mu; i++)
-        weights[i] = p.weights[i];
-    }
-
     damps = p.damps;
     cs = p.cs;
     ccumcov = p.ccumcov;
@@ -325,6 +429,14 @@ private:
     facupdateCmode = p.facupdateCmode;
 
     weightMode = p.weightMode;
+    hugePages = p.hugePages;
+    numThreads = p.numThreads;
+    eigenCheckInterval = p.eigenCheckInterval;
+    eigenCheckProbes = p.eigenCheckProbes;
+    eigenCheckTolerance = p.eigenCheckTolerance;
+    seed = p.seed;
+    blockSizes = p.blockSizes;
+    logWarnings = p.logWarnings;
   }
 
   /**
@@ -423,6 +535,23 @@ private:
 };
 
 
+/**
+ * Immutable parameter block that can be shared by many CMAES instances
+ * without copying the arrays.
+ */
+template<typename T>
+using SharedParameters = std::shared_ptr<const Parameters<T> >;
+
+/**
+ * Moves the given parameters into a shared, immutable block. Pass an lvalue
+ * through std::move() to avoid copying its arrays.
+ */
+template<typename T>
+SharedParameters<T> shareParameters(Parameters<T> parameters)
+{
+  return std::make_shared<const Parameters<T> >(std::move(parameters));
+}
+
 }  // namespace neuro_cmaes
 }  // namespace mlpack
 
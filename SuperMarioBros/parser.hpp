@@ -4,10 +4,14 @@
  *
  * Miscellaneous parser routines.
  */
+#ifndef PARSER_HPP
+#define PARSER_HPP
+
 #include <mlpack/core.hpp>
 
 #include <iostream>
 #include <string>
+#include <vector>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
@@ -151,6 +155,139 @@ class Parser {
     state = pt.get<int>("state");
   }
 
+  /**
+   * Parse the type of the message, the name of its first attribute.
+   *
+   * @return The message type, e.g. "task" or "wait".
+   */
+  std::string Type()
+  {
+    return pt.empty() ? std::string() : pt.begin()->first;
+  }
+
+  /**
+   * Parse the registration of a worker.
+   *
+   * @param replica Whether the worker keeps a replica of the optimizer.
+   */
+  void Register(bool& replica)
+  {
+    replica = pt.get_child("register").get<bool>("replica", false);
+  }
+
+  /**
+   * Parse the reason why the master turned a worker away.
+   *
+   * @param reason The reason sent by the master.
+   */
+  void Reject(std::string& reason)
+  {
+    reason = pt.get_child("reject").get<std::string>("reason");
+  }
+
+  /**
+   * Parse the id assigned to a worker.
+   *
+   * @param id The worker id.
+   */
+  void WorkerId(int& id)
+  {
+    id = pt.get_child("worker").get<int>("id");
+  }
+
+  /**
+   * Parse the id of the worker that sent a request or heartbeat message.
+   *
+   * @param worker The worker id.
+   */
+  void Sender(int& worker)
+  {
+    worker = pt.get_child(Type()).get<int>("worker");
+  }
+
+  /**
+   * Parse an evaluation task.
+   *
+   * @param generation The generation of the candidate.
+   * @param index The index of the candidate in its population.
+   * @param x The candidate solution.
+   */
+  void Task(int& generation, int& index, std::vector<double>& x)
+  {
+    const ptree& task = pt.get_child("task");
+    generation = task.get<int>("generation");
+    index = task.get<int>("index");
+
+    x.clear();
+    for (auto& item : task.get_child("x"))
+    {
+      x.push_back(item.second.get_value<double>());
+    }
+  }
+
+  /**
+   * Parse a task that the worker samples itself.
+   *
+   * @param generation The generation of the candidate.
+   * @param index The index of the candidate in its population.
+   */
+  void SeedTask(int& generation, int& index)
+  {
+    const ptree& task = pt.get_child("seedtask");
+    generation = task.get<int>("generation");
+    index = task.get<int>("index");
+  }
+
+  /**
+   * Parse the generation a worker requests the fitness values of.
+   *
+   * @param generation The requested generation.
+   */
+  void History(int& generation)
+  {
+    generation = pt.get_child("history").get<int>("generation");
+  }
+
+  /**
+   * Parse the fitness values of consecutive past generations.
+   *
+   * @param generation The first generation of the values.
+   * @param values The fitness values of the whole population, one vector
+   *        per generation.
+   */
+  void Fitness(int& generation, std::vector<std::vector<double> >& values)
+  {
+    const ptree& fitness = pt.get_child("fitness");
+    generation = fitness.get<int>("generation");
+
+    values.clear();
+    for (auto& past : fitness.get_child("values"))
+    {
+      values.push_back(std::vector<double>());
+      for (auto& item : past.second)
+      {
+        values.back().push_back(item.second.get_value<double>());
+      }
+    }
+  }
+
+  /**
+   * Parse the fitness of an evaluated task.
+   *
+   * @param worker The worker that evaluated the task.
+   * @param generation The generation of the candidate.
+   * @param index The index of the candidate in its population.
+   * @param fitness The fitness of the candidate.
+   */
+  void Result(int& worker, int& generation, int& index, double& fitness)
+  {
+    const ptree& result = pt.get_child("result");
+    worker = result.get<int>("worker");
+    generation = result.get<int>("generation");
+    index = result.get<int>("index");
+    fitness = result.get<double>("fitness");
+  }
+
   /**
    * Parse the current game image.
    *
@@ -178,4 +315,6 @@ class Parser {
 
 }; // class Parser
 
-} // namespace parser
\ No newline at end of file
+} // namespace parser
+
+#endif
@@ -2,6 +2,7 @@
 
 #include <ctime>
 #include <cmath>
+#include <stdint.h>
 
 /**
  * @class Random
@@ -86,3 +87,103 @@ public:
     return (T) aktrand / T(2.147483647e9);
   }
 };
+
+/**
+ * @class CounterRandom
+ * A counter-based random number generator (Philox4x32-10).
+ *
+ * There is no state besides the key: the numbers of a stream are a pure
+ * function of the seed and the stream coordinates, so any sample can be
+ * regenerated on its own, in any order, on any thread or host.
+ */
+template<typename T>
+class CounterRandom
+{
+  uint32_t key[2];
+public:
+  /**
+   * @param seed The key of all streams.
+   */
+  CounterRandom(uint64_t seed = 0)
+  {
+    start(seed);
+  }
+  /**
+   * @param seed The key of all streams.
+   */
+  void start(uint64_t seed)
+  {
+    key[0] = (uint32_t) seed;
+    key[1] = (uint32_t) (seed >> 32);
+  }
+  /**
+   * Fills z with (0,1)-normally distributed numbers of the stream
+   * (major, minor). The same arguments always give the same numbers.
+   * @param major E.g. the generation.
+   * @param minor E.g. the index of the offspring.
+   * @param z Receives n numbers.
+   * @param stride Distance between consecutive numbers in z.
+   */
+  void gauss(uint64_t major, uint32_t minor, T* z, int n, int stride = 1) const
+  {
+    for(int i = 0; i < n; i += 2)
+    {
+      uint32_t block[4] = {(uint32_t) (i / 2), minor, (uint32_t) major,
+          (uint32_t) (major >> 32)};
+      philox(block);
+
+      // Box-Muller transform of two uniforms in (0,1]
+      const T u1 = uniform(block[0], block[1]);
+      const T u2 = uniform(block[2], block[3]);
+      const T r = std::sqrt(T(-2)*std::log(u1));
+      const T phi = T(6.283185307179586476925)*u2;
+      z[(size_t) i*stride] = r*std::cos(phi);
+      if(i + 1 < n)
+        z[(size_t) (i + 1)*stride] = r*std::sin(phi);
+    }
+  }
+  /**
+   * Fills u with (0,1]-uniformly distributed numbers of the stream
+   * (major, minor). The same arguments always give the same numbers.
+   * @param major E.g. the generation.
+   * @param minor E.g. the index of the offspring.
+   * @param u Receives n numbers.
+   */
+  void uniform(uint64_t major, uint32_t minor, T* u, int n) const
+  {
+    for(int i = 0; i < n; i += 2)
+    {
+      uint32_t block[4] = {(uint32_t) (i / 2), minor, (uint32_t) major,
+          (uint32_t) (major >> 32)};
+      philox(block);
+
+      u[i] = uniform(block[0], block[1]);
+      if(i + 1 < n)
+        u[i + 1] = uniform(block[2], block[3]);
+    }
+  }
+private:
+  //! Uniform number in (0,1] from 53 random bits.
+  static T uniform(uint32_t hi, uint32_t lo)
+  {
+    const uint64_t bits = ((uint64_t) hi << 21) ^ (lo >> 11);
+    return (T) ((bits & ((uint64_t(1) << 53) - 1)) + 1) * T(1.0 / 9007199254740992.0);
+  }
+  //! Ten Philox rounds over the counter block.
+  void philox(uint32_t* c) const
+  {
+    uint32_t k0 = key[0], k1 = key[1];
+    for(int round = 0; round < 10; ++round)
+    {
+      const uint64_t p0 = (uint64_t) 0xD2511F53u * c[0];
+      const uint64_t p1 = (uint64_t) 0xCD9E8D57u * c[2];
+      const uint32_t c1 = c[1], c3 = c[3];
+      c[0] = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+      c[1] = (uint32_t) p1;
+      c[2] = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+      c[3] = (uint32_t) p0;
+      k0 += 0x9E3779B9u;
+      k1 += 0xBB67AE85u;
+    }
+  }
+};
@@ -0,0 +1,106 @@
+#ifndef MLPACK_METHODS_NEURO_CMAES_STATS_HPP
+#define MLPACK_METHODS_NEURO_CMAES_STATS_HPP
+
+/**
+ * @file stats.hpp
+ * @author www.github.com/Kartik-Nighania
+ *
+ * Timings of the phases of a CMAES generation.
+ *
+ * The timers are compiled in only if NEURO_CMAES_STATS is defined; otherwise
+ * NEURO_CMAES_TIME() expands to nothing and the statistics stay zero.
+ */
+
+#include <chrono>
+
+namespace mlpack {
+namespace neuro_cmaes {
+
+/**
+ * Timings of one phase.
+ */
+struct PhaseStats
+{
+  //! Seconds spent in all calls.
+  double total;
+  //! Seconds spent in the last call.
+  double last;
+  //! Number of calls.
+  unsigned long calls;
+
+  PhaseStats() : total(0), last(0), calls(0) {}
+};
+
+/**
+ * Timings of the phases of CMAES, see CMAES::statistics().
+ */
+struct CMAESStats
+{
+  //! Eigen decomposition of C.
+  PhaseStats eigen;
+  //! Drawing the offspring in samplePopulation().
+  PhaseStats sample;
+  //! Sorting the offspring by fitness.
+  PhaseStats sort;
+  //! Update of the mean and the evolution paths.
+  PhaseStats mean;
+  //! Update of C, adaptC2().
+  PhaseStats adaptC2;
+  //! testMinStdDevs().
+  PhaseStats minStdDevs;
+  //! testForTermination().
+  PhaseStats termination;
+
+  //! Whether the timers were compiled in.
+  static bool enabled()
+  {
+#ifdef NEURO_CMAES_STATS
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  //! Sets all timings to zero.
+  void reset()
+  {
+    *this = CMAESStats();
+  }
+};
+
+/**
+ * Adds the lifetime of the timer to a phase.
+ */
+class PhaseTimer
+{
+public:
+  explicit PhaseTimer(PhaseStats& stats)
+      : stats(stats), start(std::chrono::steady_clock::now())
+  {
+  }
+
+  ~PhaseTimer()
+  {
+    stats.last = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    stats.total += stats.last;
+    ++stats.calls;
+  }
+
+private:
+  PhaseStats& stats;
+  std::chrono::steady_clock::time_point start;
+};
+
+}  // namespace neuro_cmaes
+}  // namespace mlpack
+
+#ifdef NEURO_CMAES_STATS
+  //! Times the rest of the enclosing scope as the given phase of stats.
+  #define NEURO_CMAES_TIME(phase) \
+      mlpack::neuro_cmaes::PhaseTimer phaseTimer(stats.phase)
+#else
+  #define NEURO_CMAES_TIME(phase)
+#endif
+
+#endif  // MLPACK_METHODS_NEURO_CMAES_STATS_HPP
@@ -14,12 +14,14 @@
 #include "parser.hpp"
 #include "client.hpp"
 #include "messages.hpp"
+#include "distributed.hpp"
 
 
 #include "link_gene.hpp"
 #include "neuro_cmaes.hpp"
 #include "neuron_gene.hpp"
 #include "genome.hpp"
+#include "mapped_genome.hpp"
 #include "parameters.hpp"
 #include "utils.hpp"
 #include "random.hpp" 
@@ -141,12 +143,14 @@ class TaskSuperMarioBros
   }
 
   /*
-   * Fill the input vector with the screen infromations.
+   * Fill the input vector with the screen infromations. The vector is
+   * cleared first, so its capacity can be reused between steps.
    *
    * @param input The vector used to store the game screen informations.
    */
   void DiscreteActuator(std::vector<double>& input)
   {
+    input.clear();
     for (size_t i = 0; i < tiles.n_elem; ++i)
     {
       input.push_back(tiles(i));
@@ -234,6 +238,12 @@ class TaskSuperMarioBros
     int sessionLives = 0;
     size_t stepCounter = 0;
 
+    // Network input and output, reused across steps.
+    std::vector<double> input;
+    std::vector<double> output;
+    input.reserve(genome.NumInput());
+    output.reserve(genome.NumOutput());
+
     for (size_t step = 0; step < numSteps; ++step, ++stepCounter)
     {
       // Get the current game informations.
@@ -247,12 +257,10 @@ class TaskSuperMarioBros
       }
 
       // Set network input.
-      std::vector<double> input;
       DiscreteActuator(input);
 
       // Get network output.
       genome.Activate(input);
-      std::vector<double> output;
       genome.Output(output);
 
       auto biggest_position = std::max_element(std::begin(output),
@@ -326,42 +334,19 @@ class TaskSuperMarioBros
 };
 
 
-void setWeights(std::vector<LinkGene>& links, double const *x, int N)
-{
-     for(int i=0; i < N; i++) links[i].Weight(x[i]);
-}
-
 int main(int argc, char* argv[])
 {
   mlpack::math::RandomSeed(1);
 
-  std::string host(argv[1]);
-  std::string port(argv[2]);
-
-  TaskSuperMarioBros task(host, port);
-
-  CMAES<double> evo;
-  Parameters<double> params;
-
-  params.stopMaxFunEvals= 50000;
-  params.stopMaxIter= 10000;
-  params.stStopFitness.flg = true;
-  params.stStopFitness.val = 1/3266;
-  params.logWarnings = true;
-  params.lambda = 10;
-
-   const int dim = 170*6 + 6*5;
-
-  double xstart[dim];
-  for(int i=0; i<dim; i++) xstart[i] = 0.5;
-
-  double stddev[dim];
-  for(int i=0; i<dim; i++) stddev[i] = 0.3;
-
-   params.init(dim, xstart, stddev);
-
-   double *arFunvals , *const*pop ;
-   arFunvals = evo.init(params);
+  const std::string mode(argc > 1 ? argv[1] : "");
+  if ((mode == "worker" && argc < 6) || argc < 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " <host> <port>" << std::endl
+        << "       " << argv[0] << " master <listen port>" << std::endl
+        << "       " << argv[0] << " worker <master host> <master port> "
+        << "<host> <port>" << std::endl;
+    return 1;
+  }
 
   // Set seed genome for the Super Mario Bros. task.
   ssize_t numInput = 170;
@@ -432,6 +417,100 @@ int main(int argc, char* argv[])
   Genome neuralNet = Genome(neuronGenes, linkGenes, numInput, numOutput);
   neuralNet.SortLinkGenes();
 
+  // The sort groups the hidden to output links by output neuron; number the
+  // parameters in the sorted order so that the candidates are read in place.
+  // The links into every hidden neuron and the hidden to output links keep
+  // their own range of parameters, so the covariance blocks below still
+  // match, and the start point and step sizes are the same everywhere.
+  std::vector<ssize_t> oldParams;
+  neuralNet.RenumberLinkParams(oldParams);
+  if (!neuralNet.WeightsInPlace())
+  {
+    std::cerr << "The parameters of the network are not consecutive."
+        << std::endl;
+    return 1;
+  }
+
+  CMAES<double> evo;
+  Parameters<double> params;
+
+  params.stopMaxFunEvals= 50000;
+  params.stopMaxIter= 10000;
+  params.stStopFitness.flg = true;
+  params.stStopFitness.val = 1/3266;
+  params.logWarnings = true;
+  params.lambda = 10;
+
+  // The replicas of the workers sample the same candidates as the master
+  // only with the same seed; local runs keep the clock-based seed.
+  if (mode == "master" || mode == "worker")
+  {
+    params.seed = 1;
+  }
+
+   const int dim = 170*6 + 6*5;
+
+  double xstart[dim];
+  for(int i=0; i<dim; i++) xstart[i] = 0.5;
+
+  double stddev[dim];
+  for(int i=0; i<dim; i++) stddev[i] = 0.3;
+
+   params.init(dim, xstart, stddev);
+
+   // one covariance block for the incoming links of every hidden neuron and
+   // one for the hidden to output links
+   params.blockSizes.assign(6, 170);
+   params.blockSizes.push_back(6*5);
+
+   double *arFunvals , *const*pop ;
+   arFunvals = evo.init(params);
+
+  if (mode == "worker")
+  {
+    // Evaluate the candidates handed out by the master on the local
+    // emulator, sampling them with a replica of the master's optimizer.
+    TaskSuperMarioBros task(argv[4], argv[5]);
+    auto evaluate = [&](const std::vector<double>& x)
+    {
+      neuralNet.Flush();
+      neuralNet.BindWeights(x.data());
+      return task.EvalFitness(neuralNet);
+    };
+
+    distributed::Worker worker(argv[2], argv[3]);
+    worker.Run(evo, evaluate);
+    return 0;
+  }
+
+  if (mode == "master")
+  {
+    // Let the workers sample and evaluate the candidates of every generation;
+    // only the candidate indices and fitness values are exchanged with
+    // workers that keep a replica, the others get the candidates.
+    distributed::Master master(atoi(argv[2]));
+    while(!evo.testForTermination())
+    {
+      pop = evo.samplePopulation();
+      master.Evaluate(evo.sampleSize(), arFunvals, pop, evo.dimension());
+      evo.updateDistribution(arFunvals);
+    }
+
+    // Wait until every worker picked up the stop message, including the
+    // ones that are still finishing an episode.
+    master.Shutdown();
+
+    // Keep the best network found.
+    neuralNet.BindWeights(evo.XBestEver());
+    MappedGenome::Save("best.genome", neuralNet);
+    return 0;
+  }
+
+  std::string host(argv[1]);
+  std::string port(argv[2]);
+
+  TaskSuperMarioBros task(host, port);
+
  while(!evo.testForTermination() && !task.Success())
   {
     // Generate lambda new search points, sample population
@@ -443,7 +522,7 @@ int main(int argc, char* argv[])
 		//wights and flush
 		 neuralNet.Flush();
 
-		 setWeights(linkGenes, pop[i], (int) evo.dimension());
+		 neuralNet.BindWeights(pop[i]);
 
 		 arFunvals[i] = task.EvalFitness(neuralNet);
 
@@ -452,5 +531,9 @@ int main(int argc, char* argv[])
     evo.updateDistribution(arFunvals);
   }
 
+  // Keep the best network found.
+  neuralNet.BindWeights(evo.XBestEver());
+  MappedGenome::Save("best.genome", neuralNet);
+
   return 0;
 }
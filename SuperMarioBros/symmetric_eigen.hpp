@@ -0,0 +1,487 @@
+#ifndef MLPACK_METHODS_NEURO_CMAES_SYMMETRIC_EIGEN_HPP
+#define MLPACK_METHODS_NEURO_CMAES_SYMMETRIC_EIGEN_HPP
+
+/**
+ * @file symmetric_eigen.hpp
+ * @author www.github.com/Kartik-Nighania
+ *
+ * Eigendecomposition of dense symmetric matrices stored as row pointers.
+ */
+
+#include <cmath>
+#include <cstring>
+
+#include "utils.hpp"
+
+namespace mlpack {
+namespace neuro_cmaes {
+
+/**
+ * QL algorithm with implicit shifts on a symmetric tridiagonal matrix, as
+ * left by householder(), see ql().
+ * @param d (input/output) Diagonal on input, eigenvalues on output.
+ * @param e (input) Subdiagonal in e[1..n-1], destroyed.
+ * @param n Matrix dimension.
+ * @param rotate rotate(i, c, s) applies the rotation of the eigenvectors
+ *        i and i + 1, v_i+1 = s*v_i + c*v_i+1 and v_i = c*v_i - s*v_i+1.
+ */
+template<typename T, typename Rotate>
+void qlRotations(T* d, T* e, const int n, const Rotate& rotate)
+{
+  T f(0);
+  T tst1(0);
+  const T eps(2.22e-16); // 2.0^-52.0 = 2.22e-16
+
+  // shift input e
+  T* ep1 = e;
+  for(T *ep2 = e+1, *const end = e+n; ep2 != end; ep1++, ep2++)
+    *ep1 = *ep2;
+  *ep1 = T(0); // never changed again
+
+  for(int l = 0; l < n; l++)
+  {
+    // find small subdiagonal element
+    T& el = e[l];
+    T& dl = d[l];
+    const T smallSDElement = std::fabs(dl) + std::fabs(el);
+    if(tst1 < smallSDElement)
+      tst1 = smallSDElement;
+    const T epsTst1 = eps*tst1;
+    int m = l;
+    while(m < n)
+    {
+      if(std::fabs(e[m]) <= epsTst1) break;
+      m++;
+    }
+
+    // if m == l, d[l] is an eigenvalue, otherwise, iterate.
+    if(m > l)
+    {
+      do {
+        T h, g = dl;
+        T& dl1r = d[l+1];
+        T p = (dl1r - g) / (T(2)*el);
+        T r = myhypot(p, T(1));
+
+        // compute implicit shift
+        if(p < 0) r = -r;
+        const T pr = p+r;
+        dl = el/pr;
+        h = g - dl;
+        const T dl1 = el*pr;
+        dl1r = dl1;
+        for(int i = l+2; i < n; i++) d[i] -= h;
+        f += h;
+
+        // implicit QL transformation.
+        p = d[m];
+        T c(1);
+        T c2(1);
+        T c3(1);
+        const T el1 = e[l+1];
+        T s(0);
+        T s2(0);
+        for(int i = m-1; i >= l; i--)
+        {
+          c3 = c2;
+          c2 = c;
+          s2 = s;
+          const T& ei = e[i];
+          g = c*ei;
+          h = c*p;
+          r = myhypot(p, ei);
+          e[i+1] = s*r;
+          s = ei/r;
+          c = p/r;
+          const T& di = d[i];
+          p = c*di - s*g;
+          d[i+1] = h + s*(c*g + s*di);
+
+          // accumulate transformation.
+          rotate(i, c, s);
+        }
+        p = -s*s2*c3*el1*el/dl1;
+        el = s*p;
+        dl = c*p;
+      } while(std::fabs(el) > epsTst1);
+    }
+    dl += f;
+    el = 0.0;
+  }
+}
+
+/**
+ * QL algorithm with implicit shifts on a symmetric tridiagonal matrix, as
+ * left by householder().
+ * @param d (input/output) Diagonal on input, eigenvalues on output.
+ * @param e (input) Subdiagonal in e[1..n-1], destroyed.
+ * @param V (input/output) Accumulated transformations, eigenvectors in
+ *          columns on output.
+ * @param n Matrix dimension.
+ */
+template<typename T>
+void ql(T* d, T* e, T** V, const int n)
+{
+  qlRotations(d, e, n, [V, n](const int i, const T c, const T s)
+  {
+    for(int k = 0; k < n; k++)
+    {
+      T& Vki1 = V[k][i+1];
+      const T h = Vki1;
+      T& Vki = V[k][i];
+      Vki1 = s*Vki + c*h;
+      Vki *= c; Vki -= s*h;
+    }
+  });
+}
+
+/**
+ * ql() on the transposed transformations: the eigenvectors are the rows of
+ * Vt, so that every rotation runs over two contiguous rows.
+ */
+template<typename T>
+void qlTransposed(T* d, T* e, T** Vt, const int n)
+{
+  qlRotations(d, e, n, [Vt, n](const int i, const T c, const T s)
+  {
+    T* Vi = Vt[i];
+    T* Vi1 = Vt[i+1];
+    for(int k = 0; k < n; k++)
+    {
+      const T h = Vi1[k];
+      Vi1[k] = s*Vi[k] + c*h;
+      Vi[k] *= c; Vi[k] -= s*h;
+    }
+  });
+}
+
+/**
+ * Householder reduction of the symmetric matrix V to tridiagonal form.
+ * @param V (input/output) Symmetric matrix on input, orthogonal
+ *          transformation on output.
+ * @param d (output) Diagonal of the tridiagonal matrix.
+ * @param e (output) Subdiagonal of the tridiagonal matrix in e[1..n-1].
+ * @param n Matrix dimension.
+ */
+template<typename T>
+void householder(T** V, T* d, T* e, const int n)
+{
+  for(int j = 0; j < n; j++)
+  {
+    d[j] = V[n - 1][j];
+  }
+
+  // Householder reduction to tridiagonal form
+
+  for(int i = n - 1; i > 0; i--)
+  {
+    // scale to avoid under/overflow
+    T scale = 0.0;
+    T h = 0.0;
+    for(T *pd = d, *const dend = d+i; pd != dend; pd++)
+    {
+      scale += std::fabs(*pd);
+    }
+    if(scale == 0.0)
+    {
+      e[i] = d[i-1];
+      for(int j = 0; j < i; j++)
+      {
+        d[j] = V[i-1][j];
+        V[i][j] = 0.0;
+        V[j][i] = 0.0;
+      }
+    }
+    else
+    {
+      // generate Householder vector
+      for(T *pd = d, *const dend = d+i; pd != dend; pd++)
+      {
+        *pd /= scale;
+        h += *pd * *pd;
+      }
+      T& dim1 = d[i-1];
+      T f = dim1;
+      T g = f > 0 ? -std::sqrt(h) : std::sqrt(h);
+      e[i] = scale*g;
+      h = h - f* g;
+      dim1 = f - g;
+      memset((void *) e, 0, (size_t)i*sizeof(T));
+
+      // apply similarity transformation to remaining columns
+      for(int j = 0; j < i; j++)
+      {
+        f = d[j];
+        V[j][i] = f;
+        T& ej = e[j];
+        g = ej + V[j][j]* f;
+        for(int k = j + 1; k <= i - 1; k++)
+        {
+          T& Vkj = V[k][j];
+          g += Vkj*d[k];
+          e[k] += Vkj*f;
+        }
+        ej = g;
+      }
+      f = 0.0;
+      for(int j = 0; j < i; j++)
+      {
+        T& ej = e[j];
+        ej /= h;
+        f += ej* d[j];
+      }
+      T hh = f / (h + h);
+      for(int j = 0; j < i; j++)
+      {
+        e[j] -= hh*d[j];
+      }
+      for(int j = 0; j < i; j++)
+      {
+        T& dj = d[j];
+        f = dj;
+        g = e[j];
+        for(int k = j; k <= i - 1; k++)
+        {
+          V[k][j] -= f*e[k] + g*d[k];
+        }
+        dj = V[i-1][j];
+        V[i][j] = 0.0;
+      }
+    }
+    d[i] = h;
+  }
+
+  // accumulate transformations
+  const int nm1 = n-1;
+  for(int i = 0; i < nm1; i++)
+  {
+    T h;
+    T& Vii = V[i][i];
+    V[n-1][i] = Vii;
+    Vii = 1.0;
+    h = d[i+1];
+    if(h != 0.0)
+    {
+      for(int k = 0; k <= i; k++)
+      {
+        d[k] = V[k][i+1] / h;
+      }
+      for(int j = 0; j <= i; j++) {
+        T g = 0.0;
+        for(int k = 0; k <= i; k++)
+        {
+          T* Vk = V[k];
+          g += Vk[i+1]* Vk[j];
+        }
+        for(int k = 0; k <= i; k++)
+        {
+          V[k][j] -= g*d[k];
+        }
+      }
+    }
+    for(int k = 0; k <= i; k++)
+    {
+      V[k][i+1] = 0.0;
+    }
+  }
+  for(int j = 0; j < n; j++)
+  {
+    T& Vnm1j = V[n-1][j];
+    d[j] = Vnm1j;
+    Vnm1j = 0.0;
+  }
+  V[n-1][n-1] = 1.0;
+  e[0] = 0.0;
+}
+
+/**
+ * Computes eigenvalues and eigenvectors of a symmetric matrix.
+ * @param Q (input/output) Symmetric matrix on input, normalized eigenvectors
+ *          in columns on output.
+ * @param diag (output) n eigenvalues.
+ * @param rgtmp n+1 dimensional vector for temporal use.
+ * @param n Matrix dimension.
+ */
+template<typename T>
+void symmetricEigen(T** Q, T* diag, T* rgtmp, const int n)
+{
+  householder(Q, diag, rgtmp, n);
+  ql(diag, rgtmp, Q, n);
+}
+
+/**
+ * householder() on the matrices of lanes [k0, k1). Element (i, j) of the
+ * matrix of lane k is V[(i*n + j)*lanes + k] and element i of a vector is
+ * d[i*lanes + k], so that every step runs over contiguous lanes. Each lane
+ * sees the same operations as with householder(); a lane whose column is
+ * already reduced takes the general path with guarded divisions, which
+ * leaves it as householder() would.
+ * @param work 4*lanes values for temporary use.
+ */
+template<typename T>
+void householderLanes(T* V, T* d, T* e, T* work, const int n,
+    const int lanes, const int k0, const int k1)
+{
+  T* scale = work;
+  T* h = work + lanes;
+  T* f = work + 2*lanes;
+  T* g = work + 3*lanes;
+  const size_t row = (size_t) n*lanes;
+
+  for(int j = 0; j < n; j++)
+    for(int k = k0; k < k1; k++)
+      d[j*lanes + k] = V[(n - 1)*row + j*lanes + k];
+
+  // Householder reduction to tridiagonal form
+  for(int i = n - 1; i > 0; i--)
+  {
+    T* Vi = V + i*row;
+    for(int k = k0; k < k1; k++)
+    {
+      scale[k] = T(0);
+      h[k] = T(0);
+    }
+    for(int j = 0; j < i; j++)
+      for(int k = k0; k < k1; k++)
+        scale[k] += std::fabs(d[j*lanes + k]);
+
+    // generate Householder vector, d[0..i-1] is zero if scale is
+    for(int j = 0; j < i; j++)
+      for(int k = k0; k < k1; k++)
+      {
+        T& dj = d[j*lanes + k];
+        dj = scale[k] != T(0) ? dj / scale[k] : T(0);
+        h[k] += dj*dj;
+      }
+    for(int k = k0; k < k1; k++)
+    {
+      T& dim1 = d[(i - 1)*lanes + k];
+      f[k] = dim1;
+      g[k] = f[k] > 0 ? -std::sqrt(h[k]) : std::sqrt(h[k]);
+      e[i*lanes + k] = scale[k]*g[k];
+      h[k] = h[k] - f[k]*g[k];
+      dim1 = f[k] - g[k];
+    }
+    for(int j = 0; j < i; j++)
+      for(int k = k0; k < k1; k++)
+        e[j*lanes + k] = T(0);
+
+    // apply similarity transformation to remaining columns
+    for(int j = 0; j < i; j++)
+    {
+      T* Vj = V + j*row;
+      for(int k = k0; k < k1; k++)
+      {
+        f[k] = d[j*lanes + k];
+        Vj[i*lanes + k] = f[k];
+        g[k] = e[j*lanes + k] + Vj[j*lanes + k]*f[k];
+      }
+      for(int l = j + 1; l <= i - 1; l++)
+      {
+        const T* Vlj = V + l*row + j*lanes;
+        const T* dl = d + l*lanes;
+        T* el = e + l*lanes;
+        for(int k = k0; k < k1; k++)
+        {
+          g[k] += Vlj[k]*dl[k];
+          el[k] += Vlj[k]*f[k];
+        }
+      }
+      for(int k = k0; k < k1; k++)
+        e[j*lanes + k] = g[k];
+    }
+    for(int k = k0; k < k1; k++)
+      f[k] = T(0);
+    for(int j = 0; j < i; j++)
+      for(int k = k0; k < k1; k++)
+      {
+        T& ej = e[j*lanes + k];
+        if(h[k] != T(0))
+          ej /= h[k];
+        f[k] += ej*d[j*lanes + k];
+      }
+    // hh, kept in scale
+    for(int k = k0; k < k1; k++)
+      scale[k] = h[k] != T(0) ? f[k] / (h[k] + h[k]) : T(0);
+    for(int j = 0; j < i; j++)
+      for(int k = k0; k < k1; k++)
+        e[j*lanes + k] -= scale[k]*d[j*lanes + k];
+    for(int j = 0; j < i; j++)
+    {
+      for(int k = k0; k < k1; k++)
+      {
+        f[k] = d[j*lanes + k];
+        g[k] = e[j*lanes + k];
+      }
+      for(int l = j; l <= i - 1; l++)
+      {
+        T* Vlj = V + l*row + j*lanes;
+        const T* el = e + l*lanes;
+        const T* dl = d + l*lanes;
+        for(int k = k0; k < k1; k++)
+          Vlj[k] -= f[k]*el[k] + g[k]*dl[k];
+      }
+      for(int k = k0; k < k1; k++)
+      {
+        d[j*lanes + k] = V[(i - 1)*row + j*lanes + k];
+        Vi[j*lanes + k] = T(0);
+      }
+    }
+    for(int k = k0; k < k1; k++)
+      d[i*lanes + k] = h[k];
+  }
+
+  // accumulate transformations
+  for(int i = 0; i < n - 1; i++)
+  {
+    for(int k = k0; k < k1; k++)
+    {
+      T& Vii = V[i*row + i*lanes + k];
+      V[(n - 1)*row + i*lanes + k] = Vii;
+      Vii = T(1);
+      h[k] = d[(i + 1)*lanes + k];
+    }
+    for(int l = 0; l <= i; l++)
+      for(int k = k0; k < k1; k++)
+        d[l*lanes + k] = h[k] != T(0) ?
+            V[l*row + (i + 1)*lanes + k] / h[k] : T(0);
+    for(int j = 0; j <= i; j++)
+    {
+      for(int k = k0; k < k1; k++)
+        g[k] = T(0);
+      for(int l = 0; l <= i; l++)
+      {
+        const T* Vl = V + l*row;
+        for(int k = k0; k < k1; k++)
+          g[k] += Vl[(i + 1)*lanes + k]*Vl[j*lanes + k];
+      }
+      for(int l = 0; l <= i; l++)
+      {
+        T* Vlj = V + l*row + j*lanes;
+        const T* dl = d + l*lanes;
+        for(int k = k0; k < k1; k++)
+          Vlj[k] -= g[k]*dl[k];
+      }
+    }
+    for(int l = 0; l <= i; l++)
+      for(int k = k0; k < k1; k++)
+        V[l*row + (i + 1)*lanes + k] = T(0);
+  }
+  for(int j = 0; j < n; j++)
+    for(int k = k0; k < k1; k++)
+    {
+      T& Vnm1j = V[(n - 1)*row + j*lanes + k];
+      d[j*lanes + k] = Vnm1j;
+      Vnm1j = T(0);
+    }
+  for(int k = k0; k < k1; k++)
+  {
+    V[(n - 1)*row + (n - 1)*lanes + k] = T(1);
+    e[k] = T(0);
+  }
+}
+
+}  // namespace neuro_cmaes
+}  // namespace mlpack
+
+#endif  // MLPACK_METHODS_NEURO_CMAES_SYMMETRIC_EIGEN_HPP
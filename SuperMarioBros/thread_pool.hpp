@@ -0,0 +1,164 @@
+#ifndef MLPACK_METHODS_NEURO_CMAES_THREAD_POOL_HPP
+#define MLPACK_METHODS_NEURO_CMAES_THREAD_POOL_HPP
+
+/**
+ * @file thread_pool.hpp
+ * @author www.github.com/Kartik-Nighania
+ *
+ * Fixed size thread pool for data parallel loops.
+ */
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mlpack {
+namespace neuro_cmaes {
+
+/**
+ * @class ThreadPool
+ * Runs parallel loops on a fixed set of threads.
+ *
+ * parallelFor() splits a range into one contiguous chunk per thread, always
+ * in the same way for the same range and pool size, and the calling thread
+ * works on the first chunk. Dispatching a loop does not allocate.
+ */
+class ThreadPool
+{
+public:
+  /**
+   * @param threads Number of threads including the caller, at least one.
+   */
+  explicit ThreadPool(int threads = 1)
+      : task(0),
+        context(0),
+        taskBegin(0),
+        taskEnd(0),
+        round(0),
+        pending(0),
+        stopping(false)
+  {
+    for(int i = 1; i < threads; ++i)
+      workers.push_back(std::thread(&ThreadPool::work, this, i));
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for(size_t i = 0; i < workers.size(); ++i)
+      workers[i].join();
+  }
+
+  //! Number of threads including the caller.
+  int size() const { return (int) workers.size() + 1; }
+
+  /**
+   * Bounds of chunk i when [begin, end) is split into the given number of
+   * chunks.
+   */
+  static void chunk(int begin, int end, int chunks, int i, int& first,
+      int& last)
+  {
+    const long n = end - begin;
+    first = begin + (int) (n*i / chunks);
+    last = begin + (int) (n*(i + 1) / chunks);
+  }
+
+  /**
+   * Calls f(first, last) on disjoint chunks covering [begin, end) and
+   * returns when all of them are done.
+   */
+  template<typename F>
+  void parallelFor(int begin, int end, const F& f)
+  {
+    if(workers.empty() || end - begin < 2)
+    {
+      if(begin < end)
+        f(begin, end);
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      task = &ThreadPool::invoke<F>;
+      context = &f;
+      taskBegin = begin;
+      taskEnd = end;
+      pending = (int) workers.size();
+      ++round;
+    }
+    wake.notify_all();
+
+    int first, last;
+    chunk(begin, end, size(), 0, first, last);
+    if(first < last)
+      f(first, last);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+  }
+
+private:
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator=(const ThreadPool&);
+
+  template<typename F>
+  static void invoke(const void* f, int first, int last)
+  {
+    (*static_cast<const F*>(f))(first, last);
+  }
+
+  void work(int id)
+  {
+    unsigned long seen = 0;
+    for(;;)
+    {
+      void (*current)(const void*, int, int);
+      const void* currentContext;
+      int first, last;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return stopping || round != seen; });
+        if(stopping)
+          return;
+        seen = round;
+        current = task;
+        currentContext = context;
+        chunk(taskBegin, taskEnd, size(), id, first, last);
+      }
+
+      if(first < last)
+        current(currentContext, first, last);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if(--pending == 0)
+        done.notify_one();
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+
+  //! Current loop body and range.
+  void (*task)(const void*, int, int);
+  const void* context;
+  int taskBegin;
+  int taskEnd;
+  //! Incremented for every loop, so that workers run each loop once.
+  unsigned long round;
+  //! Workers that have not finished the current loop.
+  int pending;
+  bool stopping;
+};
+
+}  // namespace neuro_cmaes
+}  // namespace mlpack
+
+#endif  // MLPACK_METHODS_NEURO_CMAES_THREAD_POOL_HPP
@@ -2,14 +2,13 @@
 #define UTILS_HPP
 
 #include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <cmath>
 #include <ctime>
 #include <algorithm>
 #include <string>
-
-#include <boost/random.hpp>
-
-typedef boost::mt19937 RNGType;  // Choose random number generator.
+#include <stdint.h>
 
 namespace mlpack {
 namespace neuro_cmaes 
@@ -71,6 +70,20 @@ T myhypot(T a, T b)
     return T(0);
 }
 
+//! Size of a cache line in bytes, used to align rows of the matrices.
+const size_t cacheLineSize = 64;
+
+/**
+ * Round a row length up to a whole number of cache lines, so that each row of
+ * a matrix stored in one block starts on its own cache line.
+ */
+template<typename T>
+int paddedLength(int len)
+{
+  const int perLine = (int) (cacheLineSize / sizeof(T));
+  return (len + perLine - 1) / perLine * perLine;
+}
+
 inline double sigmoid(double x)
  { 
   return 1.0 / (1.0 + exp(-x));
@@ -81,51 +94,57 @@ inline double relu(double x)
   return (x > 0)? x:0;
  }
 
-// Random number generator.
-RNGType rng;
-
-// Set seed for random number generator
-void Seed(int seedVal)
- {
-  rng.seed(seedVal);
- }
-
-// Set seed by time for random number generator
-void TimeSeed() 
+/**
+ * exp(x) with a relative error below 1e-14, for x clamped to [-708, 709].
+ * x = n ln(2) + r with |r| <= ln(2) / 2, e^r is a Taylor polynomial of
+ * degree 11 and 2^n is assembled in the exponent bits. There are no branches
+ * or calls, so loops over arrays of fastExp() vectorize.
+ */
+inline double fastExp(double x)
 {
-  rng.seed(time(0));
+  // Adding 1.5 * 2^52 rounds to an integer kept in the low mantissa bits.
+  const double shift = 6755399441055744.0;
+  x = std::min(std::max(x, -708.0), 709.0);
+  const double kd = x * 1.4426950408889634 + shift;
+  const double n = kd - shift;
+  const double r = x - n * 6.93147180369123816490e-01
+                     - n * 1.90821492927058770002e-10;
+
+  double p = 1.0 / 39916800;
+  p = p * r + 1.0 / 3628800;
+  p = p * r + 1.0 / 362880;
+  p = p * r + 1.0 / 40320;
+  p = p * r + 1.0 / 5040;
+  p = p * r + 1.0 / 720;
+  p = p * r + 1.0 / 120;
+  p = p * r + 1.0 / 24;
+  p = p * r + 1.0 / 6;
+  p = p * r + 0.5;
+  p = p * r + 1.0;
+  p = p * r + 1.0;
+
+  int64_t kBits, shiftBits;
+  std::memcpy(&kBits, &kd, sizeof(kd));
+  std::memcpy(&shiftBits, &shift, sizeof(shift));
+  const int64_t scaleBits = (kBits - shiftBits + 1023) << 52;
+  double scale;
+  std::memcpy(&scale, &scaleBits, sizeof(scale));
+  return p * scale;
 }
 
-// Returns randomly either 1 or -1
-int RandPosNeg()
- {
-  boost::random::uniform_int_distribution<> dist(0, 1);
-  return dist(rng);
- }
-
-// Returns a random integer between [x, y]
-// in case of ( 0 .. 1 ) returns 0
-int RandInt(int x, int y)
- {
-	boost::random::uniform_int_distribution<> dist(x, y);
-    return dist(rng);
- }
-
-// Return a random float between [0, 1]
-double RandFloat() 
+//! sigmoid(x) through fastExp(), absolute error below 5e-15.
+inline double fastSigmoid(double x)
 {
-  boost::random::uniform_01<> dist;
-  return dist(rng); 
+  return 1.0 / (1.0 + fastExp(-x));
 }
 
-// Return a random float between [x, y]
-double RandFloat(double x, double y) {
-  boost::random::uniform_real_distribution<> dist(x, y);
-  return dist(rng);
+//! tanh(x) through fastExp(), absolute error below 5e-15.
+inline double fastTanh(double x)
+{
+  const double t = fastExp(-2.0 * std::fabs(x));
+  return std::copysign((1.0 - t) / (1.0 + t), x);
 }
 
-
-
 }  // namespace mlpack
 }  // namespace neuro_cmaes
 